@@ -0,0 +1,108 @@
+"""Cross-implementation benchmark: runs the same positions through script.cpp and script.py.
+
+Both programs are driven through their --bench mode, so the engines are timed
+without any game I/O. Moves and scores must agree; node counts and speed are
+reported per board size.
+
+Usage: python bench.py [--cpp ./tictactoe] [--positions FILE] [--mem MB]
+"""
+import argparse
+import os
+import subprocess
+import sys
+from collections import defaultdict
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+
+# "<depth> <compact position>" with X to move; '.' marks an empty cell.
+# Depths are kept low enough for the Python engine to finish in about a minute.
+DEFAULT_SUITE = [
+    "100 .........",
+    "100 ....O....",
+    "100 X...O....",
+    "100 O.X.X.O..",
+    "5 ................",
+    "5 .....O..........",
+    "4 X....O....O.....",
+    "4 XO...O..X..O....",
+    "3 ............O............",
+    "3 X.....O.....O.....X......",
+    "3 XO....OX....O.....X...O..",
+    "2 ..............O.....................",
+    "2 X......O.......O....X......O........",
+    "2 XOX...O.O.....X.....O......X..O.....",
+]
+
+
+def run_engine(command, suite):
+    """Returns one (move, score, nodes, microseconds) tuple per position and the peak RSS in KiB."""
+    result = subprocess.run(command, input="\n".join(suite) + "\n", capture_output=True,
+                            text=True, check=True, cwd=HERE)
+    rows = []
+    peak_rss_kb = -1
+    for line in result.stdout.splitlines():
+        if line.startswith("# peak-rss-kb"):
+            peak_rss_kb = int(line.split()[-1])
+        elif line.strip():
+            rows.append(tuple(int(field) for field in line.split()))
+    if len(rows) != len(suite):
+        raise RuntimeError(f"{command[0]} answered {len(rows)} of {len(suite)} positions")
+    return rows, peak_rss_kb
+
+
+def build_cpp():
+    binary = os.path.join(HERE, "tictactoe_bench")
+    subprocess.run(["g++", "-O2", "-std=c++17", "-pthread", "-o", binary,
+                    os.path.join(HERE, "script.cpp")], check=True)
+    return binary
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("--cpp", help="compiled script.cpp (built with g++ -O2 if omitted)")
+    parser.add_argument("--positions", help="file with one '<depth> <position>' per line")
+    parser.add_argument("--mem", help="memory budget in MB passed to the C++ engine")
+    args = parser.parse_args()
+
+    suite = DEFAULT_SUITE
+    if args.positions:
+        with open(args.positions) as f:
+            suite = [line.strip() for line in f if line.strip()]
+
+    cpp_command = [args.cpp or build_cpp(), "--bench"]
+    if args.mem:
+        cpp_command += ["--mem", args.mem]
+    cpp, cpp_rss = run_engine(cpp_command, suite)
+    py, py_rss = run_engine([sys.executable, os.path.join(HERE, "script.py"), "--bench"], suite)
+
+    mismatches = 0
+    totals = defaultdict(lambda: [0, 0, 0, 0, 0])  # positions, cpp nodes/us, py nodes/us
+    for spec, (c_move, c_score, c_nodes, c_us), (p_move, p_score, p_nodes, p_us) in zip(suite, cpp, py):
+        depth, position = spec.split()
+        if (c_move, c_score) != (p_move, p_score):
+            mismatches += 1
+            print(f"MISMATCH depth {depth} {position}: cpp {c_move}/{c_score} py {p_move}/{p_score}")
+        size = int(len(position) ** 0.5)
+        row = totals[size]
+        row[0] += 1
+        row[1] += c_nodes
+        row[2] += c_us
+        row[3] += p_nodes
+        row[4] += p_us
+
+    print(f"{'size':>4} {'pos':>4} {'cpp nodes':>11} {'cpp knps':>9} "
+          f"{'py nodes':>11} {'py knps':>9} {'speedup':>8}")
+    for size in sorted(totals):
+        count, c_nodes, c_us, p_nodes, p_us = totals[size]
+        c_knps = c_nodes / max(c_us, 1) * 1000
+        p_knps = p_nodes / max(p_us, 1) * 1000
+        print(f"{size}x{size:<2} {count:>4} {c_nodes:>11} {c_knps:>9.0f} "
+              f"{p_nodes:>11} {p_knps:>9.0f} {p_us / max(c_us, 1):>7.1f}x")
+
+    print(f"peak RSS: cpp {cpp_rss} KiB, py {py_rss} KiB")
+    print(f"{len(suite) - mismatches}/{len(suite)} positions agree")
+    return 1 if mismatches else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
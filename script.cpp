@@ -6,17 +6,137 @@
 #include <ctime>
 #include <algorithm>
 #include <iomanip>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <sstream>
+#include <fstream>
+#include <cstdio>
+#include <cstring>
+#include <future>
+#include <chrono>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <unordered_set>
+#include <cmath>
+#include <cctype>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define TTT_HAVE_MMAP 1
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#define TTT_HAVE_SOCKETS 1
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/uio.h>
+#include <sys/wait.h>
+#include <poll.h>
+#include <csignal>
+#include <cerrno>
+#endif
+
+#if defined(__AVX2__) || defined(__BMI2__)
+#include <immintrin.h>
+#endif
 
 using namespace std;
 
+// USDT probes (provider "tictactoe") for tracing live searches with bpftrace or
+// perf. With <sys/sdt.h> each probe is a single nop until a tracer attaches;
+// without it the probes compile away entirely.
+#if defined(__has_include)
+#if __has_include(<sys/sdt.h>)
+#include <sys/sdt.h>
+#define TTT_HAVE_SDT 1
+#endif
+#endif
+
+#ifdef TTT_HAVE_SDT
+#define TTT_PROBE2(name, a, b) DTRACE_PROBE2(tictactoe, name, a, b)
+#define TTT_PROBE3(name, a, b, c) DTRACE_PROBE3(tictactoe, name, a, b, c)
+#else
+#define TTT_PROBE2(name, a, b) do {} while (0)
+#define TTT_PROBE3(name, a, b, c) do {} while (0)
+#endif
+
+#if defined(__GNUC__) || defined(__clang__)
+#define TTT_PREFETCH(addr) __builtin_prefetch(addr)
+#else
+#define TTT_PREFETCH(addr) ((void)(addr))
+#endif
+
+inline int popCount64(uint64_t bits) {
+#if defined(__GNUC__) || defined(__clang__)
+    return __builtin_popcountll(bits);
+#else
+    int count = 0;
+    for (; bits; bits &= bits - 1) count++;
+    return count;
+#endif
+}
+
+// Index of the lowest set bit; bits must be non-zero
+inline int lowestBitIndex(uint64_t bits) {
+#if defined(__GNUC__) || defined(__clang__)
+    return __builtin_ctzll(bits);
+#else
+    int index = 0;
+    while (!(bits & 1)) {
+        bits >>= 1;
+        index++;
+    }
+    return index;
+#endif
+}
+
+// Mask with only the k-th (0-based) set bit of bits
+inline uint64_t selectBit(uint64_t bits, int k) {
+#ifdef __BMI2__
+    return _pdep_u64(uint64_t(1) << k, bits);
+#else
+    for (; k > 0; k--) bits &= bits - 1;
+    return bits & (~bits + 1);
+#endif
+}
+
+// SplitMix64 step, used to fill the Zobrist table deterministically
+inline uint64_t splitMix64(uint64_t& state) {
+    uint64_t z = (state += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
 class Board {
 public:
     static constexpr char EMPTY = ' ';
+    static constexpr int MAX_CELLS = 36;
     
 private:
     int size;
     vector<char> cells;
     vector<vector<int>> winLines;
+    uint64_t hashKey;
+
+    // One random key per (cell, symbol); index 0 for 'X', 1 for anything else
+    static const vector<uint64_t>& zobristTable() {
+        static const vector<uint64_t> table = [] {
+            vector<uint64_t> keys(MAX_CELLS * 2 + 1);
+            uint64_t state = 0x5EED5EED5EED5EEDULL;
+            for (auto& key : keys) key = splitMix64(state);
+            return keys;
+        }();
+        return table;
+    }
+
+    static uint64_t zobrist(int index, char symbol) {
+        if (symbol == EMPTY) return 0;
+        return zobristTable()[index * 2 + (symbol == 'X' ? 0 : 1)];
+    }
 
     void generateWinLines() {
         int n = size;
@@ -52,18 +172,40 @@ public:
             throw invalid_argument("Board size must be between 3 and 6");
         }
         cells.resize(size * size, EMPTY);
+        // Non-zero base key so the empty board never looks like an unused cache slot
+        hashKey = zobristTable()[MAX_CELLS * 2] ^ static_cast<uint64_t>(size);
         generateWinLines();
     }
 
     int getSize() const { return size; }
+
+    // Zobrist key of the current position, maintained incrementally by set()
+    uint64_t getHash() const { return hashKey; }
+
+    // Key the position would have after placing symbol on an empty cell
+    uint64_t hashAfter(int index, char symbol) const {
+        return hashKey ^ zobrist(index, symbol);
+    }
     
     const vector<vector<int>>& getWinLines() const { return winLines; }
 
+    // Each win line as a bitmask over cell indices
+    vector<uint64_t> getWinMasks() const {
+        vector<uint64_t> masks;
+        for (const auto& line : winLines) {
+            uint64_t mask = 0;
+            for (int idx : line) mask |= uint64_t(1) << idx;
+            masks.push_back(mask);
+        }
+        return masks;
+    }
+
     char get(int index) const {
         return cells[index];
     }
 
     void set(int index, char symbol) {
+        hashKey ^= zobrist(index, cells[index]) ^ zobrist(index, symbol);
         cells[index] = symbol;
     }
 
@@ -107,28 +249,47 @@ public:
         return '\0'; // No winner
     }
 
+    // Parses row-major cells with '.' for empty, e.g. "X...O...." for a 3x3 board;
+    // the board size is taken from the string length
+    static Board fromCompact(const string& text) {
+        int n = 3;
+        while (n * n < static_cast<int>(text.size())) n++;
+        if (n * n != static_cast<int>(text.size())) {
+            throw invalid_argument("Compact position length must be a square: " + text);
+        }
+        Board board(n);
+        for (int i = 0; i < n * n; i++) {
+            if (text[i] != '.' && text[i] != 'X' && text[i] != 'O') {
+                throw invalid_argument("Compact position may only hold X, O and '.': " + text);
+            }
+            if (text[i] != '.') board.set(i, text[i]);
+        }
+        return board;
+    }
+
     Board copy() const {
         Board newBoard(size);
         newBoard.cells = cells;
+        newBoard.hashKey = hashKey;
         return newBoard;
     }
 
-    void display() const {
+    void display(ostream& out = cout) const {
         int n = size;
         string separator(n * 5 + 1, '-');
-        cout << "\n" << separator << endl;
+        out << "\n" << separator << endl;
         
         for (int r = 0; r < n; r++) {
-            cout << "|";
+            out << "|";
             for (int c = 0; c < n; c++) {
                 int idx = r * n + c;
                 if (cells[idx] != EMPTY) {
-                    cout << " " << cells[idx] << "  |";
+                    out << " " << cells[idx] << "  |";
                 } else {
-                    cout << " " << setw(2) << setfill('0') << idx << " |";
+                    out << " " << setw(2) << setfill('0') << idx << " |";
                 }
             }
-            cout << endl << separator << endl;
+            out << endl << separator << endl;
         }
     }
 };
@@ -180,218 +341,3949 @@ public:
     }
 };
 
-// AI Engine with Minimax
-class AIEngine {
+// A file opened for reading. Its contents stay reachable through the handle
+// even after the path is replaced, as saving a snapshot does with rename().
+class OpenFile {
 private:
-    static const int WIN_SCORE = 1000000;
-    static const int LOSS_SCORE = -1000000;
-    
-    char aiSymbol;
-    char humanSymbol;
-    int maxDepth;
+    string filePath;
+#ifdef TTT_HAVE_MMAP
+    int fd = -1;
+#else
+    unique_ptr<ifstream> stream;
+#endif
 
 public:
-    AIEngine(char aiSym, char humanSym, int depth) 
-        : aiSymbol(aiSym), humanSymbol(humanSym), maxDepth(depth) {}
+    explicit OpenFile(const string& path) : filePath(path) {
+#ifdef TTT_HAVE_MMAP
+        fd = open(path.c_str(), O_RDONLY);
+        if (fd < 0) throw runtime_error("Cannot open " + path);
+#else
+        stream.reset(new ifstream(path, ios::binary));
+        if (!*stream) throw runtime_error("Cannot open " + path);
+#endif
+    }
 
-    int evaluateBoard(const Board& board) const {
-        int score = 0;
-        int n = board.getSize();
+    OpenFile(const OpenFile&) = delete;
+    OpenFile& operator=(const OpenFile&) = delete;
 
-        for (const auto& line : board.getWinLines()) {
-            int myCount = 0, oppCount = 0;
-            
-            for (int idx : line) {
-                char val = board.get(idx);
-                if (val == aiSymbol) myCount++;
-                else if (val == humanSymbol) oppCount++;
-            }
+#ifdef TTT_HAVE_MMAP
+    OpenFile(OpenFile&& other) noexcept : filePath(move(other.filePath)), fd(other.fd) { other.fd = -1; }
+    ~OpenFile() {
+        if (fd >= 0) close(fd);
+    }
+
+    int descriptor() const { return fd; }
+#else
+    OpenFile(OpenFile&& other) noexcept = default;
+
+    ifstream& input() { return *stream; }
+#endif
+
+    const string& path() const { return filePath; }
+};
+
+// Owns the memory behind a lookup table. Small tables live on the heap; large
+// ones are anonymous mappings with a huge-page hint, and tables loaded from disk
+// are private file mappings prefaulted at map time.
+class TableMemory {
+private:
+    enum Kind { NONE, HEAP, MAPPED };
+
+    Kind kind = NONE;
+    char* base = nullptr;
+    size_t bytes = 0;
 
-            if (myCount > 0 && oppCount > 0) continue;
+    static const size_t HUGE_PAGE_BYTES = size_t(2) << 20;
+    static const size_t PAGE_BYTES = 4096;
 
-            if (myCount > 0) {
-                if (myCount == n) score += WIN_SCORE;
-                else if (myCount == n - 1) score += 50000;
-                else if (myCount == n - 2) score += 1000;
-                else if (myCount >= 2) score += 10;
+    // Value of a "Field: N kB" line in a /proc file in bytes, SIZE_MAX if absent
+    static size_t procBytes(const char* path, const string& name) {
+        ifstream in(path);
+        string field;
+        while (in >> field) {
+            if (field == name) {
+                size_t kb;
+                if (in >> kb) return kb * 1024;
+                break;
             }
+            in.ignore(numeric_limits<streamsize>::max(), '\n');
+        }
+        return numeric_limits<size_t>::max();
+    }
+
+    // What the cgroup in dir still allows: limitFile less usageFile, SIZE_MAX
+    // when dir has no such limit
+    static size_t cgroupHeadroom(const string& dir, const char* limitFile, const char* usageFile) {
+        ifstream limitIn(dir + "/" + limitFile), usageIn(dir + "/" + usageFile);
+        string limit;
+        size_t usage;
+        if (!(limitIn >> limit) || limit == "max" || !(usageIn >> usage)) return numeric_limits<size_t>::max();
+        size_t bytes = strtoull(limit.c_str(), nullptr, 10);
+        return bytes > usage ? bytes - usage : 0;
+    }
 
-            if (oppCount > 0) {
-                if (oppCount == n) score -= WIN_SCORE;
-                else if (oppCount == n - 1) score -= 55000;
-                else if (oppCount == n - 2) score -= 2000;
-                else if (oppCount >= 2) score -= 20;
+    // Memory this process can still have, or SIZE_MAX where that cannot be read.
+    // Under overcommit, mmap and calloc succeed well beyond it, and the process is
+    // only killed later, when the pages are first touched. The smallest of:
+    // MemAvailable for the whole host; the headroom of this process's memory
+    // cgroup and each of its ancestors, which the kernel enforces with its own
+    // OOM killer (memory.max on v2, memory.limit_in_bytes on v1); and the
+    // address space left under RLIMIT_AS.
+    static size_t availableBytes() {
+        size_t available = procBytes("/proc/meminfo", "MemAvailable:");
+#ifdef TTT_HAVE_MMAP
+        ifstream cgroups("/proc/self/cgroup");
+        string line;
+        while (getline(cgroups, line)) {
+            size_t first = line.find(':'), second = line.find(':', first + 1);
+            if (first == string::npos || second == string::npos) continue;
+            string controllers = "," + line.substr(first + 1, second - first - 1) + ",";
+            bool unified = controllers == ",,";
+            if (!unified && controllers.find(",memory,") == string::npos) continue;
+            const char* roots[] = {"/sys/fs/cgroup", "/sys/fs/cgroup/unified", "/sys/fs/cgroup/memory"};
+            for (int r = unified ? 0 : 2; r < (unified ? 2 : 3); r++) {
+                // Walk up to the root of the hierarchy; directories that are not
+                // visible from inside a cgroup namespace are simply not found
+                for (string path = line.substr(second + 1);; path = path.substr(0, path.rfind('/'))) {
+                    string dir = roots[r] + path;
+                    available = min(available, unified
+                        ? cgroupHeadroom(dir, "memory.max", "memory.current")
+                        : cgroupHeadroom(dir, "memory.limit_in_bytes", "memory.usage_in_bytes"));
+                    if (path.empty() || path == "/") break;
+                }
             }
         }
-        return score;
+
+        struct rlimit limit;
+        if (getrlimit(RLIMIT_AS, &limit) == 0 && limit.rlim_cur != RLIM_INFINITY) {
+            size_t mapped = procBytes("/proc/self/status", "VmSize:");
+            if (mapped == numeric_limits<size_t>::max()) mapped = 0;
+            size_t cap = static_cast<size_t>(limit.rlim_cur);
+            available = min(available, cap > mapped ? cap - mapped : 0);
+        }
+#endif
+        return available;
     }
 
-    int minimax(Board& board, int depth, int alpha, int beta, bool isMaximizing) {
-        char winner = board.checkWinner();
-        if (winner == aiSymbol) return WIN_SCORE;
-        if (winner == humanSymbol) return LOSS_SCORE;
-        if (winner == 'D') return 0;
+    // Writes one byte per page so every page is committed now, while the caller
+    // can still choose a smaller size, instead of during the first searches
+    void touchPages() {
+        volatile char* page = base;
+        for (size_t offset = 0; offset < bytes; offset += PAGE_BYTES) page[offset] = 0;
+    }
 
-        if (depth == 0) return evaluateBoard(board);
+    void release() {
+#ifdef TTT_HAVE_MMAP
+        if (kind == MAPPED) munmap(base, bytes);
+#endif
+        if (kind == HEAP) free(base);
+        kind = NONE;
+        base = nullptr;
+        bytes = 0;
+    }
 
-        vector<int> emptyCells = board.getEmptyCells();
+public:
+    TableMemory() = default;
+    TableMemory(const TableMemory&) = delete;
+    TableMemory& operator=(const TableMemory&) = delete;
 
-        if (isMaximizing) {
-            int maxEval = numeric_limits<int>::min();
-            for (int i : emptyCells) {
-                board.set(i, aiSymbol);
-                int evalScore = minimax(board, depth - 1, alpha, beta, false);
-                board.set(i, Board::EMPTY);
-                maxEval = max(maxEval, evalScore);
-                alpha = max(alpha, evalScore);
-                if (beta <= alpha) break;
-            }
-            return maxEval;
-        } else {
-            int minEval = numeric_limits<int>::max();
-            for (int i : emptyCells) {
-                board.set(i, humanSymbol);
-                int evalScore = minimax(board, depth - 1, alpha, beta, true);
-                board.set(i, Board::EMPTY);
-                minEval = min(minEval, evalScore);
-                beta = min(beta, evalScore);
-                if (beta <= alpha) break;
+    TableMemory(TableMemory&& other) noexcept
+        : kind(other.kind), base(other.base), bytes(other.bytes) {
+        other.kind = NONE;
+        other.base = nullptr;
+        other.bytes = 0;
+    }
+
+    TableMemory& operator=(TableMemory&& other) noexcept {
+        if (this != &other) {
+            release();
+            swap(kind, other.kind);
+            swap(base, other.base);
+            swap(bytes, other.bytes);
+        }
+        return *this;
+    }
+
+    ~TableMemory() { release(); }
+
+    // Zero-filled block of the given size, faulted in before it is returned; throws
+    // bad_alloc when it cannot be had or would not fit in the memory still free
+    static TableMemory allocate(size_t size) {
+        if (size > availableBytes()) throw bad_alloc();
+        TableMemory memory;
+#ifdef TTT_HAVE_MMAP
+        if (size >= HUGE_PAGE_BYTES) {
+            void* mapped = mmap(nullptr, size, PROT_READ | PROT_WRITE,
+                                MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if (mapped != MAP_FAILED) {
+#ifdef MADV_HUGEPAGE
+                madvise(mapped, size, MADV_HUGEPAGE);
+#endif
+                memory.kind = MAPPED;
+                memory.base = static_cast<char*>(mapped);
+                memory.bytes = size;
+                memory.touchPages();
+                return memory;
             }
-            return minEval;
         }
+#endif
+        memory.base = static_cast<char*>(calloc(size, 1));
+        if (memory.base == nullptr) throw bad_alloc();
+        memory.kind = HEAP;
+        memory.bytes = size;
+        memory.touchPages();
+        return memory;
     }
 
-    int getBestMove(Board& board) {
-        int bestScore = numeric_limits<int>::min();
-        int bestMove = -1;
-        
-        for (int i : board.getEmptyCells()) {
-            board.set(i, aiSymbol);
-            int score = minimax(board, maxDepth, numeric_limits<int>::min(), 
-                               numeric_limits<int>::max(), false);
-            board.set(i, Board::EMPTY);
-            if (score > bestScore) {
-                bestScore = score;
-                bestMove = i;
+    // Copy-on-write view of a whole file, with every page faulted in up front so
+    // the first probes after loading do not stall. Falls back to a bulk read.
+    static TableMemory mapFile(OpenFile& file) {
+        TableMemory memory;
+#ifdef TTT_HAVE_MMAP
+        struct stat info;
+        if (fstat(file.descriptor(), &info) != 0 || info.st_size <= 0) {
+            throw runtime_error("Cannot read " + file.path());
+        }
+        size_t size = static_cast<size_t>(info.st_size);
+        int flags = MAP_PRIVATE;
+#ifdef MAP_POPULATE
+        flags |= MAP_POPULATE;
+#endif
+        void* mapped = mmap(nullptr, size, PROT_READ | PROT_WRITE, flags, file.descriptor(), 0);
+        if (mapped == MAP_FAILED) throw runtime_error("Cannot map " + file.path());
+        madvise(mapped, size, MADV_WILLNEED);
+        memory.kind = MAPPED;
+        memory.base = static_cast<char*>(mapped);
+        memory.bytes = size;
+#else
+        ifstream& in = file.input();
+        in.seekg(0, ios::end);
+        size_t size = static_cast<size_t>(in.tellg());
+        memory = allocate(size);
+        in.seekg(0);
+        if (!in.read(memory.base, static_cast<streamsize>(size))) {
+            throw runtime_error("Cannot read " + file.path());
+        }
+#endif
+        return memory;
+    }
+
+    // Shared mapping of a POSIX shared-memory object. The process that creates the
+    // object sizes it to size bytes; others wait until that is done. At most size
+    // bytes of an existing object are mapped, so a larger segment left by another
+    // process does not exceed this process's own budget.
+    static TableMemory openShared(const string& name, size_t size) {
+        TableMemory memory;
+#ifdef TTT_HAVE_MMAP
+        string objectName = name[0] == '/' ? name : "/" + name;
+        int fd = -1;
+        off_t existing = 0;
+        for (int attempt = 0; fd < 0; attempt++) {
+            fd = shm_open(objectName.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+            if (fd >= 0) {
+                if (ftruncate(fd, static_cast<off_t>(size)) != 0) {
+                    close(fd);
+                    shm_unlink(objectName.c_str());
+                    throw runtime_error("Cannot size shared memory " + objectName);
+                }
+                existing = static_cast<off_t>(size);
+                break;
+            }
+            if (errno != EEXIST) throw runtime_error("Cannot open shared memory " + objectName);
+            fd = shm_open(objectName.c_str(), O_RDWR, 0);
+            if (fd < 0) {
+                // Removed again between the two opens; try to create it once more
+                if (errno == ENOENT && attempt < 10) continue;
+                throw runtime_error("Cannot open shared memory " + objectName);
+            }
+            // The creator truncates right after creating, so this wait is short
+            struct stat info;
+            for (int wait = 0; wait < 5000; wait++) {
+                if (fstat(fd, &info) != 0) break;
+                existing = info.st_size;
+                if (existing > 0) break;
+                this_thread::sleep_for(chrono::milliseconds(1));
+            }
+            if (existing <= 0) {
+                close(fd);
+                throw runtime_error("Shared memory " + objectName + " was never sized");
             }
         }
-        return bestMove;
+        size_t mappedSize = min(static_cast<size_t>(existing), size);
+        void* mapped = mmap(nullptr, mappedSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        close(fd);
+        if (mapped == MAP_FAILED) throw runtime_error("Cannot map shared memory " + objectName);
+        memory.kind = MAPPED;
+        memory.base = static_cast<char*>(mapped);
+        memory.bytes = mappedSize;
+#else
+        (void)size;
+        throw runtime_error("Shared-memory tables are not supported on this platform: " + name);
+#endif
+        return memory;
     }
+
+    char* data() const { return base; }
+    size_t size() const { return bytes; }
 };
 
-// AI Player
-class AIPlayer : public Player {
+// Direct-mapped cache of static evaluations, keyed by Board::getHash().
+// Kept separate from the search itself so leaf scores survive between moves.
+// Each slot stores its key XORed with its data, so a slot torn by a concurrent
+// writer (another process sharing the table) fails verification and reads as
+// a miss instead of returning a wrong score; no locks are needed.
+class EvalCache {
 private:
-    AIEngine engine;
+    // Other threads and processes sharing the table read and write the same
+    // slots, so both words are atomic; a torn pair fails the XOR check instead
+    struct Entry {
+        atomic<uint64_t> check;  // key ^ data
+        atomic<uint64_t> data;   // score in the low 32 bits
+    };
+    static_assert(sizeof(Entry) == 2 * sizeof(uint64_t), "Entry must match the dump layout");
+#if __cpp_lib_atomic_is_always_lock_free
+    static_assert(atomic<uint64_t>::is_always_lock_free, "shared slots need lock-free atomics");
+#endif
+
+    TableMemory memory;
+    Entry* entries;
+    size_t count;
+    size_t mask;
+
+    static size_t roundDown(size_t entryCount) {
+        size_t rounded = 1;
+        while (rounded * 2 <= entryCount) rounded *= 2;
+        return rounded;
+    }
+
+    void attach(TableMemory table, size_t offset, size_t entryCount) {
+        memory = move(table);
+        entries = reinterpret_cast<Entry*>(memory.data() + offset);
+        count = entryCount;
+        mask = count - 1;
+    }
 
 public:
-    AIPlayer(char sym, char humanSym, int boardSize) 
-        : Player(sym), engine(sym, humanSym, getMaxDepth(boardSize)) {}
+    static const size_t DEFAULT_ENTRIES = size_t(1) << 16;
 
-    static int getMaxDepth(int boardSize) {
-        switch (boardSize) {
-            case 3: return 100; // Effectively infinite for 3x3
-            case 4: return 6;
-            case 5: return 5;
-            case 6: return 4;
-            default: return 4;
+    static constexpr size_t MIN_ENTRIES = 1024;
+
+    static size_t entryBytes() { return sizeof(Entry); }
+
+    // entryCount is rounded down to a power of two. If the memory is not
+    // available the table is halved until it fits, trading hit rate for memory.
+    explicit EvalCache(size_t entryCount = DEFAULT_ENTRIES) {
+        size_t rounded = roundDown(entryCount);
+        while (true) {
+            try {
+                attach(TableMemory::allocate(rounded * sizeof(Entry)), 0, rounded);
+                return;
+            } catch (const bad_alloc&) {
+                if (rounded <= MIN_ENTRIES) throw;
+                rounded /= 2;
+            }
         }
     }
 
-    int getMove(Board& board) override {
-        cout << "AI is thinking..." << endl;
-        return engine.getBestMove(board);
+    // Cache in the named POSIX shared-memory segment, created with entryCount
+    // slots if it does not exist yet. An existing segment is used up to
+    // entryCount slots, or up to its own size when that is smaller.
+    static EvalCache openShared(const string& name, size_t entryCount) {
+        size_t rounded = roundDown(entryCount);
+        TableMemory table = TableMemory::openShared(name, rounded * sizeof(Entry));
+        size_t slots = roundDown(table.size() / sizeof(Entry));
+        EvalCache cache(1);
+        cache.attach(move(table), 0, slots);
+        return cache;
+    }
+
+    // Cache backed by a dump that write() left at offset inside file.
+    // Throws runtime_error if the file does not hold a complete dump there.
+    static EvalCache mapFile(OpenFile& file, size_t offset) {
+        const string& path = file.path();
+        TableMemory memory = TableMemory::mapFile(file);
+        uint64_t stored = 0;
+        if (offset % alignof(Entry) != 0 || offset + sizeof(stored) > memory.size()) {
+            throw runtime_error("No evaluation cache in " + path);
+        }
+        memcpy(&stored, memory.data() + offset, sizeof(stored));
+        size_t tableOffset = offset + sizeof(stored);
+        if (stored == 0 || (stored & (stored - 1)) != 0 ||
+            stored > (memory.size() - tableOffset) / sizeof(Entry)) {
+            throw runtime_error("Truncated evaluation cache in " + path);
+        }
+        EvalCache cache(1);
+        cache.attach(move(memory), tableOffset, static_cast<size_t>(stored));
+        return cache;
+    }
+
+    bool probe(uint64_t key, int& score) const {
+        const Entry& entry = entries[key & mask];
+        uint64_t data = entry.data.load(memory_order_relaxed);
+        if ((entry.check.load(memory_order_relaxed) ^ data) != key) return false;
+        score = static_cast<int32_t>(static_cast<uint32_t>(data));
+        return true;
+    }
+
+    // Starts loading the slot for key so a later probe does not stall on memory
+    void prefetch(uint64_t key) const {
+        TTT_PREFETCH(&entries[key & mask]);
+    }
+
+    void store(uint64_t key, int score) {
+        uint64_t data = static_cast<uint32_t>(score);
+        Entry& entry = entries[key & mask];
+        entry.data.store(data, memory_order_relaxed);
+        entry.check.store(key ^ data, memory_order_relaxed);
+    }
+
+    size_t size() const { return count; }
+
+    // Raw dump: entry count followed by the table in one contiguous write.
+    // Must start at a multiple of 8 in the file for mapFile() to accept it.
+    void write(ostream& out) const {
+        uint64_t stored = count;
+        out.write(reinterpret_cast<const char*>(&stored), sizeof(stored));
+        out.write(reinterpret_cast<const char*>(entries),
+                  static_cast<streamsize>(count * sizeof(Entry)));
     }
 };
 
-// Game class
-class Game {
-private:
-    Board board;
-    HumanPlayer human;
-    AIPlayer ai;
+// Counters for the most recent getBestMove() call
+struct SearchStats {
+    uint64_t nodes = 0;
+    uint64_t quiescenceNodes = 0;
+    uint64_t evalProbes = 0;
+    uint64_t evalHits = 0;
+
+    double evalHitRate() const {
+        return evalProbes == 0 ? 0.0 : static_cast<double>(evalHits) / evalProbes;
+    }
+};
+
+// Engine settings taken from the command line
+struct EngineConfig {
+    // Upper bound in bytes for all engine tables; 0 keeps the built-in sizes
+    size_t memoryBudget = 0;
+
+    // Worker threads for batch modes such as position generation; 0 means one
+    int threads = 0;
+
+    // Search depth override; 0 uses the per-size depths below
+    int depth = 0;
+
+    // Depth for each board size from calibration; 0 uses AIPlayer::getMaxDepth
+    int sizeDepths[7] = {0, 0, 0, 0, 0, 0, 0};
+
+    // Self-play games each worker thread searches interleaved; 1 plays them one by one
+    int interleave = 1;
+
+    // Evaluation cache size from calibration, used when there is no memory budget
+    size_t evalCacheSize = 0;
+
+    // Name of a shared-memory segment holding the evaluation cache, shared by
+    // every engine process started with the same name; empty keeps it private
+    string sharedCacheName;
 
+    // Policy/value network file; when it matches the board size the AI plays by
+    // network-guided MCTS instead of minimax
+    string netPath;
+
+    // Fixed per-engine cost outside the tables: PV table, search stack, bookkeeping
+    static const size_t SEARCH_OVERHEAD_BYTES = 64 * 1024;
+
+    // Stack each extra worker thread is assumed to touch. Searches keep their own
+    // explicit stack, so this is far less than the address space a thread reserves.
+    static const size_t THREAD_STACK_BYTES = 1024 * 1024;
+
+    // Settings for one of workers workers, each running enginesPerWorker engines
+    // over a single evaluation cache. The budget first pays for every engine's
+    // fixed overhead and the stacks of extraThreads threads. The rest goes to the
+    // caches: it is split between the workers, unless they all share one
+    // --shm-cache segment.
+    EngineConfig forWorkers(int workers, int enginesPerWorker, int extraThreads) const {
+        EngineConfig share = *this;
+        if (memoryBudget == 0) return share;
+        size_t fixed = static_cast<size_t>(workers) * enginesPerWorker * SEARCH_OVERHEAD_BYTES +
+                       static_cast<size_t>(extraThreads) * THREAD_STACK_BYTES;
+        size_t tables = memoryBudget > fixed ? memoryBudget - fixed : 0;
+        if (sharedCacheName.empty()) tables /= max(1, workers);
+        // evalCacheEntries() takes one engine's overhead off again
+        share.memoryBudget = tables + SEARCH_OVERHEAD_BYTES;
+        return share;
+    }
+
+    size_t evalCacheEntries() const {
+        if (memoryBudget == 0) return evalCacheSize > 0 ? evalCacheSize : EvalCache::DEFAULT_ENTRIES;
+        size_t tableBytes = memoryBudget > SEARCH_OVERHEAD_BYTES
+            ? memoryBudget - SEARCH_OVERHEAD_BYTES : 0;
+        return max(tableBytes / EvalCache::entryBytes(), EvalCache::MIN_ENTRIES);
+    }
+};
+
+// Peak resident set size of this process in KiB, or -1 where it cannot be read.
+// Linux's VmHWM is used first because ru_maxrss carries over the parent's peak
+// across exec, which would hide the engine's own footprint under a bench driver.
+long peakRssKb() {
+    ifstream status("/proc/self/status");
+    string field;
+    while (status >> field) {
+        if (field == "VmHWM:") {
+            long kb;
+            if (status >> kb) return kb;
+            break;
+        }
+    }
+#ifdef TTT_HAVE_MMAP
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) return -1;
+#ifdef __APPLE__
+    return usage.ru_maxrss / 1024;
+#else
+    return usage.ru_maxrss;
+#endif
+#else
+    return -1;
+#endif
+}
+
+// How long one move may take in a game played on a clock
+struct MoveBudget {
+    double softMs;  // no new iteration is started past half of this
+    double hardMs;  // the running iteration is abandoned at this point
+};
+
+// Splits the remaining clock across the moves still to come. The hard limit never
+// exceeds a fixed share of what is left, so the clock cannot run out while the
+// engine is thinking; it only gets shorter, and the search shallower.
+class TimeManager {
 public:
-    Game(int boardSize) 
-        : board(boardSize), human('O'), ai('X', 'O', boardSize) {}
+    static constexpr double HARD_SHARE = 0.4;
+    static constexpr double HARD_OVER_SOFT = 4.0;
+    static constexpr double SAFETY_MS = 5.0;
 
-    void play() {
-        cout << "Welcome to " << board.getSize() << "x" << board.getSize() 
-             << " Tic-Tac-Toe!" << endl;
-        cout << "You are '" << human.getSymbol() << "', AI is '" 
-             << ai.getSymbol() << "'" << endl;
-        board.display();
+    static MoveBudget allocate(double remainingMs, int emptyCells) {
+        int ownMovesLeft = max(1, (emptyCells + 1) / 2);
+        double usable = max(0.0, remainingMs - SAFETY_MS);
+        MoveBudget budget;
+        budget.softMs = usable / (ownMovesLeft + 2);
+        budget.hardMs = min(usable * HARD_SHARE, budget.softMs * HARD_OVER_SOFT);
+        budget.softMs = min(budget.softMs, budget.hardMs);
+        return budget;
+    }
 
-        // Randomly choose who starts first
-        srand(static_cast<unsigned>(time(nullptr)));
-        Player* currentPlayer = (rand() % 2 == 0) ? 
-            static_cast<Player*>(&human) : static_cast<Player*>(&ai);
-        
-        if (currentPlayer == &human) {
-            cout << "\n>> You go first!" << endl;
-        } else {
-            cout << "\n>> AI goes first!" << endl;
+    // A best move that keeps changing between iterations is worth more time
+    static void onBestMoveChange(MoveBudget& budget) {
+        budget.softMs = min(budget.softMs * 1.5, budget.hardMs);
+    }
+};
+
+// AI Engine with Minimax
+class AIEngine {
+private:
+    static const int WIN_SCORE = 1000000;
+    static const int LOSS_SCORE = -1000000;
+    
+    static const int MAX_PLY = Board::MAX_CELLS + 1;
+    static const int QUIESCENCE_MAX_PLIES = 8;
+
+    char aiSymbol;
+    char humanSymbol;
+    int maxDepth;
+    // Scores are from the AI's point of view, so the same position needs separate
+    // slots for an X engine and an O engine once a cache is shared between them
+    static const uint64_t EVAL_KEY_O = 0x6A09E667F3BCC908ULL;
+
+    shared_ptr<EvalCache> evalCache;
+    size_t evalCacheLimit;
+    uint64_t evalKeySalt;
+    bool sharedCache;
+    future<EvalCache> pendingCache;
+    SearchStats stats;
+
+    // Triangular PV table: pvTable[ply] holds the best line from ply onwards
+    int pvTable[MAX_PLY][MAX_PLY];
+    int pvLength[MAX_PLY];
+    vector<int> principalVariation;
+    vector<int> previousPv;
+    bool followPv = false;
+    int lastScore = 0;
+    int lastDepth = 0;  // plies searched by the last completed iteration
+
+    // Clock state for getTimedMove(); minimax gives up once deadline has passed
+    bool timeLimited = false;
+    bool aborted = false;
+    chrono::steady_clock::time_point deadline;
+
+    void updatePv(int ply, int move) {
+        pvTable[ply][ply] = move;
+        for (int p = ply + 1; p < pvLength[ply + 1]; p++) {
+            pvTable[ply][p] = pvTable[ply + 1][p];
         }
+        pvLength[ply] = max(pvLength[ply + 1], ply + 1);
+    }
 
-        while (true) {
-            if (board.isFull()) {
-                char result = board.checkWinner();
-                if (result == ai.getSymbol()) {
-                    cout << "AI Wins!" << endl;
-                } else if (result == human.getSymbol()) {
-                    cout << "You Win!" << endl;
-                } else {
-                    cout << "It's a Draw! Game Over." << endl;
+    // Moves the previous PV's move for this ply to the front while the search
+    // is still following that line. Returns true if the first move is the PV move.
+    bool orderPvFirst(int* moves, int count, int ply) {
+        bool onPv = followPv && ply < static_cast<int>(previousPv.size());
+        followPv = false;
+        if (!onPv) return false;
+        int* it = find(moves, moves + count, previousPv[ply]);
+        if (it == moves + count) return false;
+        rotate(moves, it, it + 1);
+        return true;
+    }
+
+    // Keeps the last PV for this search if both sides have since played its first
+    // two moves, so the rest of the expected line is tried first again
+    void carryOverPv(const Board& board) {
+        followPv = false;
+        if (previousPv.size() > 2 && board.get(previousPv[0]) == aiSymbol &&
+            board.get(previousPv[1]) == humanSymbol) {
+            previousPv.erase(previousPv.begin(), previousPv.begin() + 2);
+            for (int move : previousPv) {
+                if (!board.isEmpty(move)) {
+                    previousPv.clear();
+                    break;
                 }
-                break;
             }
+        } else {
+            previousPv.clear();
+        }
+        followPv = !previousPv.empty();
+    }
 
-            int move = currentPlayer->getMove(board);
-            board.set(move, currentPlayer->getSymbol());
-            board.display();
+    // Win lines through each cell for the frontier kernel, four slots per cell
+    // (row, column and up to two diagonals) padded to whole 8-cell blocks. Unused
+    // slots point one past the last line, whose per-line values are always zero.
+    struct FrontierTables {
+        static const int MAX_LINES = 2 * 6 + 2;
+        static const int PADDED_CELLS = 40;
+        int lineCount;
+        alignas(32) int32_t cellLines[4][PADDED_CELLS];
+    };
 
-            char winner = board.checkWinner();
-            if (winner != '\0') {
-                if (winner == human.getSymbol()) {
-                    cout << "You Win!" << endl;
-                } else if (winner == ai.getSymbol()) {
-                    cout << "AI Wins!" << endl;
-                } else {
-                    cout << "It's a Draw!" << endl;
+    static const FrontierTables& frontierTables(int size) {
+        static const vector<FrontierTables> tables = [] {
+            vector<FrontierTables> all;
+            for (int n = 3; n <= 6; n++) {
+                FrontierTables t;
+                Board board(n);
+                const auto& lines = board.getWinLines();
+                t.lineCount = static_cast<int>(lines.size());
+                int used[FrontierTables::PADDED_CELLS] = {};
+                for (auto& slots : t.cellLines) fill(begin(slots), end(slots), t.lineCount);
+                for (int l = 0; l < t.lineCount; l++) {
+                    for (int idx : lines[l]) t.cellLines[used[idx]++][idx] = l;
                 }
-                break;
+                all.push_back(t);
             }
+            return all;
+        }();
+        return tables[size - 3];
+    }
 
-            // Switch player
-            currentPlayer = (currentPlayer == &human) ? 
-                static_cast<Player*>(&ai) : static_cast<Player*>(&human);
+    // Flag fields summed per cell by the frontier kernel, four bits each
+    static const int32_t FLAG_WIN = 1;         // mover completes this line
+    static const int32_t FLAG_REPLY_WIN = 16;  // opponent needs one more mark here
+    static const int32_t FLAG_NEW_THREAT = 256;  // mover would reach n-1 here
+
+    // One call of the alpha-beta search, kept on an explicit stack so that a
+    // search can stop while an evaluation-cache slot loads and resume later.
+    // ROOT loops over the root moves, NODE over a node's children, FRONTIER is a
+    // depth 1 node, QUIESCE one step of the threat search and EVAL a leaf
+    // waiting for its static score.
+    enum FrameKind : uint8_t { ROOT, NODE, FRONTIER, QUIESCE, EVAL };
+
+    struct Frame {
+        FrameKind kind;
+        bool prefetched;  // EVAL: the cache slot has been requested
+        bool isMaximizing;
+        bool onPv;
+        int depth, alpha, beta, ply, pliesLeft;
+        int best;
+        int bestMove;  // ROOT only
+        int k;         // index of the child being searched
+        int played;    // cell set by this frame while its child runs
+        int moveCount;
+        int moves[Board::MAX_CELLS];
+        // FRONTIER: the parent's static score, threat totals and per-cell sums
+        int base, replyWins, moverThreats;
+        alignas(32) int32_t cellDelta[FrontierTables::PADDED_CELLS];
+        alignas(32) int32_t cellFlags[FrontierTables::PADDED_CELLS];
+    };
+
+    static const int MAX_FRAMES = MAX_PLY + QUIESCENCE_MAX_PLIES + 2;
+    Frame frames[MAX_FRAMES];
+    int top = -1;
+    Board* searchBoard = nullptr;
+    int searchResult = -1;
+    vector<int> rootLine;
+
+    Frame& pushFrame(FrameKind kind, int depth, int alpha, int beta, bool isMaximizing, int ply,
+                     int pliesLeft = QUIESCENCE_MAX_PLIES) {
+        Frame& f = frames[++top];
+        f.kind = kind;
+        f.prefetched = false;
+        f.depth = depth;
+        f.alpha = alpha;
+        f.beta = beta;
+        f.isMaximizing = isMaximizing;
+        f.ply = ply;
+        f.pliesLeft = pliesLeft;
+        return f;
+    }
+
+    static int emptyCells(const Board& board, int* moves) {
+        int count = 0;
+        int cells = board.getSize() * board.getSize();
+        for (int i = 0; i < cells; i++) {
+            if (board.isEmpty(i)) moves[count++] = i;
         }
+        return count;
     }
-};
 
-int main() {
-    cout << string(40, '=') << endl;
-    cout << "      TIC-TAC-TOE" << endl;
-    cout << string(40, '=') << endl;
+    // Folds a child's score into f as the recursive search did; true on a cutoff
+    bool applyChildScore(Frame& f, int move, int score) {
+        if (f.isMaximizing) {
+            if (score > f.best) {
+                f.best = score;
+                updatePv(f.ply, move);
+            }
+            f.alpha = max(f.alpha, score);
+        } else {
+            if (score < f.best) {
+                f.best = score;
+                updatePv(f.ply, move);
+            }
+            f.beta = min(f.beta, score);
+        }
+        return f.beta <= f.alpha;
+    }
 
-    int size;
-    while (true) {
-        cout << "Choose board size (3-6): ";
-        
-        if (!(cin >> size)) {
-            cin.clear();
-            cin.ignore(numeric_limits<streamsize>::max(), '\n');
-            cout << "Please enter a valid number." << endl;
-            continue;
+    // Children of a depth 1 node are scored from the parent's per-line counts
+    // instead of by recursion. Each line gets its score change and flags for the
+    // mover placing a mark on it; one pass over the cell-to-lines map (eight cells
+    // at a time with AVX2) sums them per cell. A child that wins, fills the board,
+    // or is quiet (no n-1 line for quiescence to play out) is then scored
+    // directly: a quiet child is the parent's static score plus its cell's change.
+    // Every other child is searched as before, so scores, PVs, node counts and
+    // cutoffs are unchanged.
+    void prepareFrontier(const Board& board, Frame& f) const {
+        int n = board.getSize();
+        const FrontierTables& t = frontierTables(n);
+        const auto& lines = board.getWinLines();
+
+        alignas(32) int32_t lineDelta[FrontierTables::MAX_LINES + 1];
+        alignas(32) int32_t lineFlags[FrontierTables::MAX_LINES + 1];
+        f.base = f.replyWins = f.moverThreats = 0;
+        for (int l = 0; l < t.lineCount; l++) {
+            int myCount = 0, oppCount = 0;
+            for (int idx : lines[l]) {
+                char val = board.get(idx);
+                if (val == aiSymbol) myCount++;
+                else if (val == humanSymbol) oppCount++;
+            }
+            int moverCount = f.isMaximizing ? myCount : oppCount;
+            int otherCount = f.isMaximizing ? oppCount : myCount;
+            int value = lineValue(myCount, oppCount, n);
+            f.base += value;
+            lineDelta[l] = (f.isMaximizing ? lineValue(myCount + 1, oppCount, n)
+                                           : lineValue(myCount, oppCount + 1, n)) - value;
+            lineFlags[l] = 0;
+            if (otherCount == 0 && moverCount == n - 1) {
+                lineFlags[l] += FLAG_WIN;
+                f.moverThreats++;
+            }
+            if (otherCount == 0 && moverCount == n - 2) lineFlags[l] += FLAG_NEW_THREAT;
+            if (moverCount == 0 && otherCount == n - 1) {
+                lineFlags[l] += FLAG_REPLY_WIN;
+                f.replyWins++;
+            }
         }
-        
-        if (size >= 3 && size <= 6) break;
-        cout << "Please enter a number between 3 and 6." << endl;
+        lineDelta[t.lineCount] = 0;
+        lineFlags[t.lineCount] = 0;
+
+        int cells = n * n;
+#ifdef __AVX2__
+        for (int c = 0; c < cells; c += 8) {
+            __m256i delta = _mm256_setzero_si256();
+            __m256i flags = _mm256_setzero_si256();
+            for (int k = 0; k < 4; k++) {
+                __m256i idx = _mm256_load_si256(reinterpret_cast<const __m256i*>(&t.cellLines[k][c]));
+                delta = _mm256_add_epi32(delta, _mm256_i32gather_epi32(lineDelta, idx, 4));
+                flags = _mm256_add_epi32(flags, _mm256_i32gather_epi32(lineFlags, idx, 4));
+            }
+            _mm256_store_si256(reinterpret_cast<__m256i*>(&f.cellDelta[c]), delta);
+            _mm256_store_si256(reinterpret_cast<__m256i*>(&f.cellFlags[c]), flags);
+        }
+#else
+        for (int c = 0; c < cells; c++) {
+            f.cellDelta[c] = lineDelta[t.cellLines[0][c]] + lineDelta[t.cellLines[1][c]] +
+                             lineDelta[t.cellLines[2][c]] + lineDelta[t.cellLines[3][c]];
+            f.cellFlags[c] = lineFlags[t.cellLines[0][c]] + lineFlags[t.cellLines[1][c]] +
+                             lineFlags[t.cellLines[2][c]] + lineFlags[t.cellLines[3][c]];
+        }
+#endif
     }
 
+    // Runs the search on the frame stack until it finishes, returning true, or,
+    // with yieldOnProbe, until a leaf needs its evaluation-cache slot: the slot is
+    // prefetched and false returned, and the next call scores the leaf. Each frame
+    // steps exactly like the recursive alpha-beta search it stands for, so moves,
+    // scores, PVs and node counts do not depend on where a search was suspended.
+    bool runSearch(bool yieldOnProbe) {
+        Board& board = *searchBoard;
+        bool returning = false;
+        int value = 0;
+        while (true) {
+            if (returning && --top < 0) {
+                searchResult = value;
+                return true;
+            }
+            Frame& f = frames[top];
+            bool childDone = returning;
+            returning = false;
+            char mover = f.isMaximizing ? aiSymbol : humanSymbol;
+
+            switch (f.kind) {
+            case ROOT: {
+                if (!childDone) {
+                    f.moveCount = emptyCells(board, f.moves);
+                    f.onPv = orderPvFirst(f.moves, f.moveCount, 0);
+                    f.best = numeric_limits<int>::min();
+                    f.bestMove = -1;
+                    f.k = 0;
+                    rootLine.clear();
+                } else {
+                    board.set(f.played, Board::EMPTY);
+                    if (aborted) {
+                        value = -1;
+                        returning = true;
+                        continue;
+                    }
+                    // Ties go to the lowest cell so PV ordering never changes the chosen move
+                    if (value > f.best || (value == f.best && f.played < f.bestMove)) {
+                        f.best = value;
+                        f.bestMove = f.played;
+                        rootLine.assign(1, f.played);
+                        rootLine.insert(rootLine.end(), pvTable[1] + 1, pvTable[1] + pvLength[1]);
+                    }
+                    f.k++;
+                }
+                if (f.k == f.moveCount) {
+                    lastScore = f.best;
+                    lastDepth = min(f.depth + 1, f.moveCount);
+                    principalVariation = rootLine;
+                    TTT_PROBE3(iteration_done, f.depth, f.best, stats.nodes);
+                    value = f.bestMove;
+                    returning = true;
+                    continue;
+                }
+                int i = f.moves[f.k];
+                followPv = f.onPv && f.k == 0;
+                board.set(i, aiSymbol);
+                f.played = i;
+                pushFrame(NODE, f.depth, numeric_limits<int>::min(), numeric_limits<int>::max(), false, 1);
+                continue;
+            }
+
+            case NODE: {
+                bool cutoff = false;
+                if (!childDone) {
+                    if (timeLimited && (stats.nodes & 1023) == 0 && chrono::steady_clock::now() >= deadline) {
+                        aborted = true;
+                    }
+                    returning = true;
+                    value = 0;
+                    if (aborted) continue;
+                    stats.nodes++;
+                    pvLength[f.ply] = f.ply;
+                    char winner = board.checkWinner();
+                    if (winner == aiSymbol) value = WIN_SCORE;
+                    else if (winner == humanSymbol) value = LOSS_SCORE;
+                    if (winner != '\0') continue;
+                    returning = false;
+
+                    if (f.depth == 0) {
+                        f.kind = QUIESCE;
+                        f.pliesLeft = QUIESCENCE_MAX_PLIES;
+                        continue;
+                    }
+                    f.moveCount = emptyCells(board, f.moves);
+                    f.onPv = orderPvFirst(f.moves, f.moveCount, f.ply);
+                    if (f.depth == 1) {
+                        f.kind = FRONTIER;
+                        continue;
+                    }
+                    f.best = f.isMaximizing ? numeric_limits<int>::min() : numeric_limits<int>::max();
+                    f.k = 0;
+                } else {
+                    board.set(f.played, Board::EMPTY);
+                    cutoff = applyChildScore(f, f.played, value);
+                    f.k++;
+                }
+                if (cutoff || f.k == f.moveCount) {
+                    value = f.best;
+                    returning = true;
+                    continue;
+                }
+                int i = f.moves[f.k];
+                followPv = f.onPv && f.k == 0;
+                board.set(i, mover);
+                f.played = i;
+                pushFrame(NODE, f.depth - 1, f.alpha, f.beta, !f.isMaximizing, f.ply + 1);
+                continue;
+            }
+
+            case FRONTIER: {
+                bool cutoff = false;
+                if (!childDone) {
+                    prepareFrontier(board, f);
+                    f.best = f.isMaximizing ? numeric_limits<int>::min() : numeric_limits<int>::max();
+                    f.k = 0;
+                } else {
+                    board.set(f.played, Board::EMPTY);
+                    cutoff = applyChildScore(f, f.played, value);
+                    f.k++;
+                }
+                bool lastCell = f.moveCount == 1;
+                bool descended = false;
+                for (; !cutoff && f.k < f.moveCount; f.k++) {
+                    int i = f.moves[f.k];
+                    followPv = f.onPv && f.k == 0;
+                    int flags = f.cellFlags[i];
+                    bool wins = (flags & 15) != 0;
+                    // The opponent keeps a winning reply unless every such line runs through i
+                    bool quiet = ((flags >> 4) & 15) == f.replyWins && f.moverThreats == 0 && (flags >> 8) == 0;
+                    if (!wins && !lastCell && !quiet) {
+                        board.set(i, mover);
+                        f.played = i;
+                        pushFrame(NODE, 0, f.alpha, f.beta, !f.isMaximizing, f.ply + 1);
+                        descended = true;
+                        break;
+                    }
+                    // What the child node would do on entry
+                    if (timeLimited && (stats.nodes & 1023) == 0 && chrono::steady_clock::now() >= deadline) {
+                        aborted = true;
+                    }
+                    int score = 0;
+                    if (!aborted) {
+                        stats.nodes++;
+                        pvLength[f.ply + 1] = f.ply + 1;
+                        if (wins) score = f.isMaximizing ? WIN_SCORE : LOSS_SCORE;
+                        else if (!lastCell) score = f.base + f.cellDelta[i];
+                    }
+                    cutoff = applyChildScore(f, i, score);
+                }
+                if (descended) continue;
+                value = f.best;
+                returning = true;
+                continue;
+            }
+
+            // Horizon search limited to n-1 lines. A side that can complete a line
+            // wins; one facing two open n-1 lines loses; one facing a single line
+            // must block it, which is played out. Otherwise the position is quiet
+            // and gets its static score. Each block costs one ply of pliesLeft; when
+            // that runs out the static score is returned as well.
+            case QUIESCE: {
+                if (childDone) {
+                    board.set(f.played, Board::EMPTY);
+                    updatePv(f.ply, f.played);
+                    returning = true;
+                    continue;
+                }
+                int n = board.getSize();
+                int winCell = -1, blockCell = -1;
+                bool doubleThreat = false;
+
+                for (const auto& line : board.getWinLines()) {
+                    int moverCount = 0, otherCount = 0, emptyCell = -1;
+                    for (int idx : line) {
+                        char val = board.get(idx);
+                        if (val == mover) moverCount++;
+                        else if (val == Board::EMPTY) emptyCell = idx;
+                        else otherCount++;
+                    }
+                    if (moverCount == n - 1 && otherCount == 0) {
+                        if (winCell < 0) winCell = emptyCell;
+                    } else if (otherCount == n - 1 && moverCount == 0) {
+                        if (blockCell >= 0 && blockCell != emptyCell) doubleThreat = true;
+                        if (blockCell < 0) blockCell = emptyCell;
+                    }
+                }
+
+                returning = true;
+                if (winCell >= 0) {
+                    pvLength[f.ply + 1] = f.ply + 1;
+                    updatePv(f.ply, winCell);
+                    value = f.isMaximizing ? WIN_SCORE : LOSS_SCORE;
+                    continue;
+                }
+                if (doubleThreat) {
+                    value = f.isMaximizing ? LOSS_SCORE : WIN_SCORE;
+                    continue;
+                }
+                returning = false;
+                if (blockCell < 0 || f.pliesLeft == 0) {
+                    f.kind = EVAL;
+                    continue;
+                }
+
+                stats.nodes++;
+                stats.quiescenceNodes++;
+                board.set(blockCell, mover);
+                f.played = blockCell;
+                pvLength[f.ply + 1] = f.ply + 1;
+                // A block cannot complete a line for the mover, so the only way this ends is a full board
+                if (board.isFull()) {
+                    board.set(blockCell, Board::EMPTY);
+                    updatePv(f.ply, blockCell);
+                    value = 0;
+                    returning = true;
+                    continue;
+                }
+                pushFrame(QUIESCE, 0, 0, 0, !f.isMaximizing, f.ply + 1, f.pliesLeft - 1);
+                continue;
+            }
+
+            case EVAL:
+                if (yieldOnProbe && !f.prefetched) {
+                    f.prefetched = true;
+                    evalCache->prefetch(board.getHash() ^ evalKeySalt);
+                    return false;
+                }
+                value = cachedEvaluate(board);
+                returning = true;
+                continue;
+            }
+        }
+    }
+
+    int cachedEvaluate(const Board& board) {
+        stats.evalProbes++;
+        int score;
+        uint64_t key = board.getHash() ^ evalKeySalt;
+        if (evalCache->probe(key, score)) {
+            stats.evalHits++;
+            TTT_PROBE2(cache_probe, key, 1);
+            return score;
+        }
+        TTT_PROBE2(cache_probe, key, 0);
+        score = evaluateBoard(board);
+        evalCache->store(key, score);
+        return score;
+    }
+
+public:
+    AIEngine(char aiSym, char humanSym, int depth, const EngineConfig& config = EngineConfig()) 
+        : aiSymbol(aiSym), humanSymbol(humanSym), maxDepth(depth),
+          evalCache(make_shared<EvalCache>(config.sharedCacheName.empty()
+                        ? EvalCache(config.evalCacheEntries())
+                        : EvalCache::openShared(config.sharedCacheName, config.evalCacheEntries()))),
+          evalCacheLimit(config.evalCacheEntries()),
+          evalKeySalt(aiSymbol == 'X' ? 0 : EVAL_KEY_O),
+          sharedCache(!config.sharedCacheName.empty()) {}
+
+    // Engine probing and filling cache, which other engines of either side may share
+    AIEngine(char aiSym, char humanSym, int depth, shared_ptr<EvalCache> cache)
+        : aiSymbol(aiSym), humanSymbol(humanSym), maxDepth(depth),
+          evalCache(move(cache)),
+          evalCacheLimit(evalCache->size()),
+          evalKeySalt(aiSymbol == 'X' ? 0 : EVAL_KEY_O),
+          sharedCache(true) {}
+
+    const SearchStats& getStats() const { return stats; }
+
+    EvalCache& getEvalCache() { return *evalCache; }
+    const EvalCache& getEvalCache() const { return *evalCache; }
+
+    // True when the cache lives in a --shm-cache segment other processes use too
+    bool usesSharedCache() const { return sharedCache; }
+
+    // Maps a saved evaluation cache from an already opened file on a background
+    // thread. Searches keep using the current cache until the load has finished;
+    // a failed load is ignored.
+    void loadEvalCacheAsync(OpenFile file, size_t offset) {
+        auto source = make_shared<OpenFile>(move(file));
+        pendingCache = async(launch::async, [source, offset] {
+            return EvalCache::mapFile(*source, offset);
+        });
+    }
+
+    // Swaps in a background-loaded cache once it reports ready; never blocks
+    bool adoptLoadedCache() {
+        if (!pendingCache.valid() ||
+            pendingCache.wait_for(chrono::seconds(0)) != future_status::ready) {
+            return false;
+        }
+        try {
+            EvalCache loaded = pendingCache.get();
+            // A cache saved under a larger memory budget is dropped, not adopted, and
+            // a shared cache already holds more than any single saved game could add
+            if (loaded.size() > evalCacheLimit || sharedCache) return false;
+            evalCache = make_shared<EvalCache>(move(loaded));
+            return true;
+        } catch (const exception&) {
+            return false;
+        }
+    }
+
+    // Static score of one line holding myCount AI marks and oppCount human marks
+    static int lineValue(int myCount, int oppCount, int n) {
+        if (myCount > 0 && oppCount > 0) return 0;
+
+        if (myCount > 0) {
+            if (myCount == n) return WIN_SCORE;
+            if (myCount == n - 1) return 50000;
+            if (myCount == n - 2) return 1000;
+            if (myCount >= 2) return 10;
+        }
+
+        if (oppCount > 0) {
+            if (oppCount == n) return -WIN_SCORE;
+            if (oppCount == n - 1) return -55000;
+            if (oppCount == n - 2) return -2000;
+            if (oppCount >= 2) return -20;
+        }
+        return 0;
+    }
+
+    int evaluateBoard(const Board& board) const {
+        int score = 0;
+        int n = board.getSize();
+
+        for (const auto& line : board.getWinLines()) {
+            int myCount = 0, oppCount = 0;
+            
+            for (int idx : line) {
+                char val = board.get(idx);
+                if (val == aiSymbol) myCount++;
+                else if (val == humanSymbol) oppCount++;
+            }
+            score += lineValue(myCount, oppCount, n);
+        }
+        return score;
+    }
+
+    // One full-width search of every root move to the given depth. Returns -1 and
+    // leaves the previous PV and score untouched if the clock ran out part way.
+    int searchRoot(Board& board, int depth) {
+        searchBoard = &board;
+        top = -1;
+        pushFrame(ROOT, depth, 0, 0, true, 0);
+        runSearch(false);
+        return searchResult;
+    }
+
+    // Resumable form of getBestMove() for running several searches on one thread:
+    // startSearch() sets the search up, resumeSearch() runs it until it finishes
+    // (true) or has prefetched an evaluation-cache slot and yields (false), and
+    // finishSearch() returns the move. board must not change in between.
+    void startSearch(Board& board) {
+        adoptLoadedCache();
+        stats = SearchStats();
+        carryOverPv(board);
+        TTT_PROBE2(search_start, maxDepth, board.getHash());
+        searchBoard = &board;
+        top = -1;
+        pushFrame(ROOT, maxDepth, 0, 0, true, 0);
+    }
+
+    bool resumeSearch(bool yieldOnProbe = true) { return runSearch(yieldOnProbe); }
+
+    int finishSearch() {
+        previousPv = principalVariation;
+        TTT_PROBE3(search_end, searchResult, lastScore, stats.nodes);
+        return searchResult;
+    }
+
+    int getBestMove(Board& board) {
+        startSearch(board);
+        resumeSearch(false);
+        return finishSearch();
+    }
+
+    // Iterative deepening under a clock: remainingMs is what is left on this side's
+    // clock for the rest of the game. Each iteration re-searches the previous PV
+    // first. The first iteration always finishes, so a legal move is always returned.
+    int getTimedMove(Board& board, double remainingMs) {
+        auto start = chrono::steady_clock::now();
+        adoptLoadedCache();
+        stats = SearchStats();
+        carryOverPv(board);
+
+        int emptyCount = static_cast<int>(board.getEmptyCells().size());
+        MoveBudget budget = TimeManager::allocate(remainingMs, emptyCount);
+        deadline = start + chrono::microseconds(static_cast<long long>(budget.hardMs * 1000));
+        aborted = false;
+        TTT_PROBE2(search_start, -1, board.getHash());
+
+        int bestMove = -1;
+        for (int depth = 0; depth < emptyCount; depth++) {
+            timeLimited = depth > 0;
+            int move = searchRoot(board, depth);
+            if (move < 0) break;
+            if (bestMove >= 0 && move != bestMove) TimeManager::onBestMoveChange(budget);
+            bestMove = move;
+            previousPv = principalVariation;
+            followPv = true;
+            if (abs(lastScore) >= WIN_SCORE) break;
+            double elapsedMs = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+            // The next iteration costs several times this one, so only start it early on
+            if (elapsedMs >= budget.softMs / 2) break;
+        }
+        timeLimited = false;
+        aborted = false;
+        previousPv = principalVariation;
+        TTT_PROBE3(search_end, bestMove, lastScore, stats.nodes);
+        return bestMove;
+    }
+
+    // Expected line from the last search, starting with the move returned
+    const vector<int>& getPrincipalVariation() const { return principalVariation; }
+
+    int getLastScore() const { return lastScore; }
+
+    // Forgets the expected line so it is not carried into an unrelated position
+    void newGame() { previousPv.clear(); }
+
+    // Prints a one-line summary of the last search, e.g. "info depth 5 score 50 ... pv 12 7 13"
+    void printInfo(ostream& out) const {
+        ostringstream hitRate;
+        hitRate << fixed << setprecision(1) << stats.evalHitRate() * 100 << "%";
+        out << "info depth " << lastDepth
+            << " score " << lastScore
+            << " nodes " << stats.nodes
+            << " qnodes " << stats.quiescenceNodes
+            << " evalhits " << hitRate.str()
+            << " pv";
+        for (int move : principalVariation) out << " " << move;
+        out << endl;
+    }
+};
+
+// Small policy/value network for MCTS: one ReLU hidden layer over two input
+// planes (the marks of the side to move and of its opponent), a policy head with
+// one logit per cell and a tanh value head scored for the side to move. Training
+// runs in float; the file on disk holds int8 weights with one scale per tensor.
+class PolicyValueNet {
+public:
+    static const int HIDDEN = 64;
+    // Two input planes over the largest board
+    static const int N_INPUTS_MAX = 2 * Board::MAX_CELLS;
+
+    // One training example: inputs, MCTS visit distribution and the game outcome
+    struct Sample {
+        vector<float> input;
+        vector<float> policy;
+        float value;
+    };
+
+private:
+    static constexpr char FILE_MAGIC[8] = {'T', 'T', 'T', 'N', 'E', 'T', '1', '\0'};
+
+    int size;
+    int cells;
+    int inputs;
+    vector<float> w1, b1;  // HIDDEN x inputs
+    vector<float> wp, bp;  // cells x HIDDEN
+    vector<float> wv;      // HIDDEN
+    float bv = 0;
+
+    static float uniform(uint64_t& state) {
+        return static_cast<float>(splitMix64(state) >> 40) / static_cast<float>(1 << 24);
+    }
+
+    static void initLayer(vector<float>& weights, int fanIn, int fanOut, uint64_t& state) {
+        float limit = sqrt(6.0f / (fanIn + fanOut));
+        for (auto& w : weights) w = (uniform(state) * 2 - 1) * limit;
+    }
+
+    static void writeQuantized(ostream& out, const vector<float>& weights) {
+        float maxAbs = 0;
+        for (float w : weights) maxAbs = max(maxAbs, fabs(w));
+        float scale = maxAbs > 0 ? maxAbs / 127 : 1;
+        vector<int8_t> quantized(weights.size());
+        for (size_t i = 0; i < weights.size(); i++) {
+            quantized[i] = static_cast<int8_t>(lround(weights[i] / scale));
+        }
+        out.write(reinterpret_cast<const char*>(&scale), sizeof(scale));
+        out.write(reinterpret_cast<const char*>(quantized.data()),
+                  static_cast<streamsize>(quantized.size()));
+    }
+
+    static bool readQuantized(istream& in, vector<float>& weights) {
+        float scale;
+        vector<int8_t> quantized(weights.size());
+        if (!in.read(reinterpret_cast<char*>(&scale), sizeof(scale)) ||
+            !in.read(reinterpret_cast<char*>(quantized.data()), static_cast<streamsize>(quantized.size()))) {
+            return false;
+        }
+        for (size_t i = 0; i < weights.size(); i++) weights[i] = quantized[i] * scale;
+        return true;
+    }
+
+    static void writeFloats(ostream& out, const vector<float>& values) {
+        out.write(reinterpret_cast<const char*>(values.data()),
+                  static_cast<streamsize>(values.size() * sizeof(float)));
+    }
+
+    static bool readFloats(istream& in, vector<float>& values) {
+        return static_cast<bool>(in.read(reinterpret_cast<char*>(values.data()),
+                                         static_cast<streamsize>(values.size() * sizeof(float))));
+    }
+
+    // forward() for LANES consecutive rows
+    void forwardBlock(const float* in, float* hidden, float* logits, float* values) const {
+        float x[N_INPUTS_MAX * LANES], h[HIDDEN * LANES], acc[LANES];
+        for (int i = 0; i < inputs; i++) {
+            for (int b = 0; b < LANES; b++) x[i * LANES + b] = in[b * inputs + i];
+        }
+
+        for (int j = 0; j < HIDDEN; j++) {
+            const float* w = &w1[j * inputs];
+            for (int b = 0; b < LANES; b++) acc[b] = b1[j];
+            for (int i = 0; i < inputs; i++) {
+                for (int b = 0; b < LANES; b++) acc[b] += w[i] * x[i * LANES + b];
+            }
+            for (int b = 0; b < LANES; b++) h[j * LANES + b] = acc[b] > 0 ? acc[b] : 0;
+        }
+        for (int b = 0; b < LANES; b++) {
+            for (int j = 0; j < HIDDEN; j++) hidden[b * HIDDEN + j] = h[j * LANES + b];
+        }
+
+        for (int c = 0; c < cells; c++) {
+            const float* w = &wp[c * HIDDEN];
+            for (int b = 0; b < LANES; b++) acc[b] = bp[c];
+            for (int j = 0; j < HIDDEN; j++) {
+                for (int b = 0; b < LANES; b++) acc[b] += w[j] * h[j * LANES + b];
+            }
+            for (int b = 0; b < LANES; b++) logits[b * cells + c] = acc[b];
+        }
+
+        for (int b = 0; b < LANES; b++) acc[b] = bv;
+        for (int j = 0; j < HIDDEN; j++) {
+            for (int b = 0; b < LANES; b++) acc[b] += wv[j] * h[j * LANES + b];
+        }
+        for (int b = 0; b < LANES; b++) values[b] = tanh(acc[b]);
+    }
+
+    // forward() for a single row
+    void forwardRow(const float* x, float* h, float* logits, float* value) const {
+        for (int j = 0; j < HIDDEN; j++) {
+            const float* w = &w1[j * inputs];
+            float sum = b1[j];
+            for (int i = 0; i < inputs; i++) sum += w[i] * x[i];
+            h[j] = sum > 0 ? sum : 0;
+        }
+        for (int c = 0; c < cells; c++) {
+            const float* w = &wp[c * HIDDEN];
+            float sum = bp[c];
+            for (int j = 0; j < HIDDEN; j++) sum += w[j] * h[j];
+            logits[c] = sum;
+        }
+        float v = bv;
+        for (int j = 0; j < HIDDEN; j++) v += wv[j] * h[j];
+        *value = tanh(v);
+    }
+
+public:
+    PolicyValueNet(int boardSize, uint64_t seed)
+        : size(boardSize), cells(boardSize * boardSize), inputs(2 * boardSize * boardSize),
+          w1(HIDDEN * inputs), b1(HIDDEN, 0), wp(cells * HIDDEN), bp(cells, 0), wv(HIDDEN) {
+        Board check(boardSize);  // validates the size
+        initLayer(w1, inputs, HIDDEN, seed);
+        initLayer(wp, HIDDEN, cells, seed);
+        initLayer(wv, HIDDEN, 1, seed);
+    }
+
+    int getSize() const { return size; }
+    int inputCount() const { return inputs; }
+
+    void encode(const Board& board, char mover, float* out) const {
+        for (int i = 0; i < cells; i++) {
+            char c = board.get(i);
+            out[i] = (c == mover) ? 1.0f : 0.0f;
+            out[cells + i] = (c != mover && c != Board::EMPTY) ? 1.0f : 0.0f;
+        }
+    }
+
+    // Rows evaluated together by forward(); the innermost loops run across them
+    static const int LANES = 8;
+
+    // Evaluates batch input rows at once. hidden receives batch x HIDDEN
+    // activations, logits batch x cells policy logits, values one value per row.
+    // Each layer is a small matrix product with the batch as the inner dimension:
+    // full blocks of LANES rows are transposed, and every weight is loaded once
+    // per block and applied to all of its rows by a loop the compiler turns into
+    // vector instructions. Rows left over are evaluated one at a time. Every row
+    // sums its terms in the same order either way, so results do not depend on
+    // how the batch is split.
+    void forward(const float* in, int batch, float* hidden, float* logits, float* values) const {
+        int blocked = batch - batch % LANES;
+        for (int first = 0; first < blocked; first += LANES) {
+            forwardBlock(in + first * inputs, hidden + first * HIDDEN, logits + first * cells, values + first);
+        }
+        for (int b = blocked; b < batch; b++) {
+            forwardRow(in + b * inputs, hidden + b * HIDDEN, logits + b * cells, values + b);
+        }
+    }
+
+    // One SGD step on a minibatch with squared value error plus policy cross-entropy.
+    // Returns the mean loss over the batch.
+    float train(const vector<const Sample*>& batch, float learningRate) {
+        vector<float> gw1(w1.size(), 0), gb1(b1.size(), 0), gwp(wp.size(), 0), gbp(bp.size(), 0);
+        vector<float> gwv(wv.size(), 0);
+        float gbv = 0, loss = 0;
+        vector<float> h(HIDDEN), logits(cells), dh(HIDDEN);
+        float v;
+
+        for (const Sample* sample : batch) {
+            forward(sample->input.data(), 1, h.data(), logits.data(), &v);
+
+            float maxLogit = *max_element(logits.begin(), logits.end());
+            float total = 0;
+            for (auto& l : logits) total += (l = exp(l - maxLogit));
+            for (auto& l : logits) l /= total;
+
+            float dz = 2 * (v - sample->value) * (1 - v * v);
+            loss += (v - sample->value) * (v - sample->value);
+            for (int j = 0; j < HIDDEN; j++) dh[j] = wv[j] * dz;
+            gbv += dz;
+            for (int j = 0; j < HIDDEN; j++) gwv[j] += dz * h[j];
+
+            for (int c = 0; c < cells; c++) {
+                float target = sample->policy[c];
+                if (target > 0) loss -= target * log(max(logits[c], 1e-9f));
+                float dl = logits[c] - target;
+                gbp[c] += dl;
+                for (int j = 0; j < HIDDEN; j++) {
+                    gwp[c * HIDDEN + j] += dl * h[j];
+                    dh[j] += dl * wp[c * HIDDEN + j];
+                }
+            }
+
+            for (int j = 0; j < HIDDEN; j++) {
+                if (h[j] <= 0) continue;
+                gb1[j] += dh[j];
+                for (int i = 0; i < inputs; i++) gw1[j * inputs + i] += dh[j] * sample->input[i];
+            }
+        }
+
+        float step = learningRate / batch.size();
+        const float decay = 1e-4f;
+        auto apply = [&](vector<float>& w, const vector<float>& g) {
+            for (size_t i = 0; i < w.size(); i++) w[i] -= step * g[i] + learningRate * decay * w[i];
+        };
+        apply(w1, gw1);
+        apply(b1, gb1);
+        apply(wp, gwp);
+        apply(bp, gbp);
+        apply(wv, gwv);
+        bv -= step * gbv;
+        return loss / batch.size();
+    }
+
+    void save(const string& path) const {
+        ofstream out(path, ios::binary | ios::trunc);
+        if (!out) throw runtime_error("Cannot write " + path);
+        int32_t header[2] = {size, HIDDEN};
+        out.write(FILE_MAGIC, sizeof(FILE_MAGIC));
+        out.write(reinterpret_cast<const char*>(header), sizeof(header));
+        writeQuantized(out, w1);
+        writeQuantized(out, wp);
+        writeQuantized(out, wv);
+        writeFloats(out, b1);
+        writeFloats(out, bp);
+        out.write(reinterpret_cast<const char*>(&bv), sizeof(bv));
+        if (!out) throw runtime_error("Cannot write " + path);
+    }
+
+    // Throws runtime_error if path is missing or not a network file
+    static PolicyValueNet load(const string& path) {
+        ifstream in(path, ios::binary);
+        if (!in) throw runtime_error("Cannot open network " + path);
+        char magic[sizeof(FILE_MAGIC)];
+        int32_t header[2];
+        if (!in.read(magic, sizeof(magic)) || !equal(magic, magic + sizeof(magic), FILE_MAGIC) ||
+            !in.read(reinterpret_cast<char*>(header), sizeof(header)) || header[1] != HIDDEN) {
+            throw runtime_error("Not a network file: " + path);
+        }
+        PolicyValueNet net(header[0], 0);
+        if (!readQuantized(in, net.w1) || !readQuantized(in, net.wp) || !readQuantized(in, net.wv) ||
+            !readFloats(in, net.b1) || !readFloats(in, net.bp) ||
+            !in.read(reinterpret_cast<char*>(&net.bv), sizeof(net.bv))) {
+            throw runtime_error("Truncated network file: " + path);
+        }
+        return net;
+    }
+};
+
+// PUCT Monte Carlo tree search guided by a PolicyValueNet. Several games are
+// searched in lockstep: every simulation step descends one path per game and
+// evaluates all of the new leaves with a single batched forward pass.
+class MctsBatch {
+public:
+    struct Result {
+        vector<float> visits;  // per cell, at the root
+        float value;           // root value for the side to move
+    };
+
+private:
+    struct Node {
+        int move;
+        int firstChild;
+        int childCount;
+        float prior;
+        int visits;
+        float valueSum;  // for the player who made move
+    };
+
+    static constexpr float C_PUCT = 1.5f;
+    static constexpr float NOISE_WEIGHT = 0.25f;
+
+    const PolicyValueNet& net;
+
+    int selectChild(const vector<Node>& tree, const Node& parent) const {
+        float scale = C_PUCT * sqrt(static_cast<float>(max(parent.visits, 1)));
+        int best = parent.firstChild;
+        float bestScore = -numeric_limits<float>::infinity();
+        for (int c = parent.firstChild; c < parent.firstChild + parent.childCount; c++) {
+            const Node& child = tree[c];
+            float q = child.visits > 0 ? child.valueSum / child.visits : 0;
+            float u = scale * child.prior / (1 + child.visits);
+            if (q + u > bestScore) {
+                bestScore = q + u;
+                best = c;
+            }
+        }
+        return best;
+    }
+
+    // value is for the side to move at the last node of path
+    static void backup(vector<Node>& tree, const vector<int>& path, float value) {
+        for (auto it = path.rbegin(); it != path.rend(); ++it) {
+            tree[*it].visits++;
+            tree[*it].valueSum -= value;
+            value = -value;
+        }
+    }
+
+public:
+    explicit MctsBatch(const PolicyValueNet& network) : net(network) {}
+
+    // Searches every board with movers[g] to play; boards are restored before
+    // returning. With rootNoise the root priors are mixed with Dirichlet(1) noise.
+    // Stops early at deadline, once the root has been expanded and visited.
+    vector<Result> search(const vector<Board*>& boards, const vector<char>& movers,
+                          int simulations, uint64_t& rng, bool rootNoise,
+                          chrono::steady_clock::time_point deadline = chrono::steady_clock::time_point::max()) const {
+        int games = static_cast<int>(boards.size());
+        int cells = net.getSize() * net.getSize();
+        int inputs = net.inputCount();
+        vector<vector<Node>> trees(games, vector<Node>(1, Node{-1, -1, 0, 1, 0, 0}));
+        vector<vector<int>> paths(games);
+        vector<vector<int>> legal(games);
+        vector<int> pending;
+        vector<float> in(games * inputs), hidden(games * PolicyValueNet::HIDDEN),
+                      logits(games * cells), values(games);
+
+        for (int sim = 0; sim <= simulations; sim++) {
+            if (sim > 1 && chrono::steady_clock::now() >= deadline) break;
+            pending.clear();
+            for (int g = 0; g < games; g++) {
+                Board& board = *boards[g];
+                vector<Node>& tree = trees[g];
+                vector<int>& path = paths[g];
+                path.assign(1, 0);
+                char toMove = movers[g];
+                while (tree[path.back()].childCount > 0) {
+                    int child = selectChild(tree, tree[path.back()]);
+                    board.set(tree[child].move, toMove);
+                    path.push_back(child);
+                    toMove = (toMove == 'X') ? 'O' : 'X';
+                }
+
+                char winner = board.checkWinner();
+                if (winner != '\0') {
+                    backup(tree, path, winner == 'D' ? 0.0f : -1.0f);
+                } else {
+                    net.encode(board, toMove, &in[pending.size() * inputs]);
+                    legal[g] = board.getEmptyCells();
+                    pending.push_back(g);
+                }
+                for (size_t k = path.size() - 1; k > 0; k--) board.set(tree[path[k]].move, Board::EMPTY);
+            }
+            if (pending.empty()) continue;
+
+            net.forward(in.data(), static_cast<int>(pending.size()), hidden.data(), logits.data(), values.data());
+
+            for (size_t k = 0; k < pending.size(); k++) {
+                int g = pending[k];
+                vector<Node>& tree = trees[g];
+                int leaf = paths[g].back();
+                const float* l = &logits[k * cells];
+                float maxLogit = -numeric_limits<float>::infinity();
+                for (int cell : legal[g]) maxLogit = max(maxLogit, l[cell]);
+                vector<float> priors;
+                float total = 0;
+                for (int cell : legal[g]) {
+                    priors.push_back(exp(l[cell] - maxLogit));
+                    total += priors.back();
+                }
+                if (leaf == 0 && rootNoise) {
+                    vector<float> noise;
+                    float noiseTotal = 0;
+                    for (size_t c = 0; c < priors.size(); c++) {
+                        float u = static_cast<float>((splitMix64(rng) >> 11) + 1) / 9007199254740993.0f;
+                        noise.push_back(-log(u));
+                        noiseTotal += noise.back();
+                    }
+                    for (size_t c = 0; c < priors.size(); c++) {
+                        priors[c] = (1 - NOISE_WEIGHT) * priors[c] / total + NOISE_WEIGHT * noise[c] / noiseTotal;
+                    }
+                    total = 1;
+                }
+                int first = static_cast<int>(tree.size());
+                for (size_t c = 0; c < priors.size(); c++) {
+                    tree.push_back(Node{legal[g][c], -1, 0, priors[c] / total, 0, 0});
+                }
+                tree[leaf].firstChild = first;
+                tree[leaf].childCount = static_cast<int>(priors.size());
+                backup(tree, paths[g], values[k]);
+            }
+        }
+
+        vector<Result> results(games);
+        for (int g = 0; g < games; g++) {
+            const vector<Node>& tree = trees[g];
+            const Node& root = tree[0];
+            results[g].visits.assign(cells, 0);
+            for (int c = root.firstChild; c < root.firstChild + root.childCount; c++) {
+                results[g].visits[tree[c].move] = static_cast<float>(tree[c].visits);
+            }
+            results[g].value = root.visits > 0 ? -root.valueSum / root.visits : 0;
+        }
+        return results;
+    }
+};
+
+// AI Player
+class AIPlayer : public Player {
+private:
+    AIEngine engine;
+    double timeLeftMs = 0;
+    unique_ptr<PolicyValueNet> net;
+    uint64_t mctsRng = 1;
+
+public:
+    // Simulations per move when playing with a network
+    static const int MCTS_SIMULATIONS = 800;
+
+    AIPlayer(char sym, char humanSym, int boardSize, const EngineConfig& config = EngineConfig()) 
+        : Player(sym), engine(sym, humanSym, depthFor(boardSize, config), config) {
+        if (config.netPath.empty()) return;
+        try {
+            PolicyValueNet loaded = PolicyValueNet::load(config.netPath);
+            if (loaded.getSize() == boardSize) {
+                net.reset(new PolicyValueNet(std::move(loaded)));
+            } else {
+                cerr << "Network " << config.netPath << " is for " << loaded.getSize() << "x"
+                     << loaded.getSize() << " boards; using minimax" << endl;
+            }
+        } catch (const exception& e) {
+            cerr << e.what() << "; using minimax" << endl;
+        }
+    }
+
+    // Depth the AI searches at: --depth, then the calibrated depth, then the default
+    static int depthFor(int boardSize, const EngineConfig& config) {
+        if (config.depth > 0) return config.depth;
+        if (boardSize >= 3 && boardSize <= 6 && config.sizeDepths[boardSize] > 0) {
+            return config.sizeDepths[boardSize];
+        }
+        return getMaxDepth(boardSize);
+    }
+
+    static int getMaxDepth(int boardSize) {
+        switch (boardSize) {
+            case 3: return 100; // Effectively infinite for 3x3
+            case 4: return 6;
+            case 5: return 5;
+            case 6: return 4;
+            default: return 4;
+        }
+    }
+
+    AIEngine& getEngine() { return engine; }
+    const AIEngine& getEngine() const { return engine; }
+
+    // Milliseconds left on the AI's clock; 0 plays at the fixed depth instead
+    void setTimeLeft(double ms) { timeLeftMs = ms; }
+
+    int getMove(Board& board) override {
+        cout << "AI is thinking..." << endl;
+        if (net) return getNetMove(board);
+        int move = timeLeftMs > 0 ? engine.getTimedMove(board, timeLeftMs) : engine.getBestMove(board);
+        engine.printInfo(cout);
+        return move;
+    }
+
+private:
+    // Plays the most visited root move of a network-guided MCTS. On a clock the
+    // search also stops at the TimeManager's soft limit for this move.
+    int getNetMove(Board& board) {
+        auto deadline = chrono::steady_clock::time_point::max();
+        if (timeLeftMs > 0) {
+            int emptyCount = static_cast<int>(board.getEmptyCells().size());
+            MoveBudget budget = TimeManager::allocate(timeLeftMs, emptyCount);
+            deadline = chrono::steady_clock::now() + chrono::microseconds(static_cast<long long>(budget.softMs * 1000));
+        }
+        MctsBatch mcts(*net);
+        MctsBatch::Result result = mcts.search({&board}, {symbol}, MCTS_SIMULATIONS, mctsRng, false, deadline)[0];
+        int move = static_cast<int>(max_element(result.visits.begin(), result.visits.end()) - result.visits.begin());
+        int simulations = 0;
+        for (float visits : result.visits) simulations += static_cast<int>(visits);
+        ostringstream value;
+        value << fixed << setprecision(3) << result.value;
+        cout << "info mcts sims " << simulations << " value " << value.str() << " pv " << move << endl;
+        return move;
+    }
+};
+
+// A move as seen by spectators: encoded once, then shared read-only by every subscriber
+using MoveFrame = shared_ptr<const string>;
+
+#ifdef TTT_HAVE_SOCKETS
+static sockaddr_un unixSocketAddress(const string& path) {
+    sockaddr_un addr = {};
+    addr.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(addr.sun_path)) throw runtime_error("Socket path too long: " + path);
+    memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+    return addr;
+}
+#endif
+
+// One viewer of a live game. Frames queue up until flush() drains them: on POSIX
+// with writev straight from the shared buffers into the viewer's non-blocking
+// socket, elsewhere frame by frame into a stream. A viewer that stops reading
+// fills its queue; once a frame would take it past maxFrames frames or maxBytes
+// bytes it is considered too slow.
+class Spectator {
+private:
+    ostream* out = nullptr;
+    int fd = -1;
+    size_t maxFrames;
+    size_t maxBytes;
+    deque<MoveFrame> pending;
+    size_t pendingBytes = 0;
+    size_t headSent = 0;  // bytes of pending.front() already written
+
+    void consume(size_t bytes) {
+        while (bytes > 0) {
+            size_t left = pending.front()->size() - headSent;
+            if (bytes < left) {
+                headSent += bytes;
+                return;
+            }
+            bytes -= left;
+            pendingBytes -= pending.front()->size();
+            pending.pop_front();
+            headSent = 0;
+        }
+    }
+
+public:
+    static const size_t DEFAULT_MAX_FRAMES = 16;  // also the iovec count of one writev
+    static const size_t DEFAULT_MAX_BYTES = 8 * 1024;
+
+    Spectator(ostream& output, size_t frameLimit = DEFAULT_MAX_FRAMES, size_t byteLimit = DEFAULT_MAX_BYTES)
+        : out(&output), maxFrames(frameLimit), maxBytes(byteLimit) {}
+
+#ifdef TTT_HAVE_SOCKETS
+    // Takes ownership of a connected socket and makes it non-blocking
+    explicit Spectator(int socketFd, size_t frameLimit = DEFAULT_MAX_FRAMES,
+                       size_t byteLimit = DEFAULT_MAX_BYTES)
+        : fd(socketFd), maxFrames(frameLimit), maxBytes(byteLimit) {
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+        // Keep the kernel from buffering far more than the queue limit allows
+        int sendBuffer = static_cast<int>(byteLimit);
+        setsockopt(fd, SOL_SOCKET, SO_SNDBUF, &sendBuffer, sizeof(sendBuffer));
+    }
+#endif
+
+    Spectator(const Spectator&) = delete;
+    Spectator& operator=(const Spectator&) = delete;
+
+    ~Spectator() {
+#ifdef TTT_HAVE_SOCKETS
+        if (fd >= 0) close(fd);
+#endif
+    }
+
+    // Returns false when the frame does not fit in the queue and was not accepted
+    bool enqueue(const MoveFrame& frame) {
+        if (pending.size() >= maxFrames || pendingBytes + frame->size() > maxBytes) return false;
+        pending.push_back(frame);
+        pendingBytes += frame->size();
+        return true;
+    }
+
+    // Writes as much of the queue as the viewer will take without blocking; the
+    // shared buffers are never copied. Returns false once the viewer has gone.
+    bool flush() {
+#ifdef TTT_HAVE_SOCKETS
+        if (fd >= 0) {
+            while (!pending.empty()) {
+                iovec iov[DEFAULT_MAX_FRAMES];
+                int count = 0;
+                for (auto it = pending.begin(); it != pending.end() && count < static_cast<int>(DEFAULT_MAX_FRAMES);
+                     ++it, ++count) {
+                    size_t skip = (count == 0) ? headSent : 0;
+                    iov[count].iov_base = const_cast<char*>((*it)->data() + skip);
+                    iov[count].iov_len = (*it)->size() - skip;
+                }
+                ssize_t written = writev(fd, iov, count);
+                if (written < 0 && errno == EINTR) continue;
+                if (written < 0) return errno == EAGAIN || errno == EWOULDBLOCK;
+                consume(static_cast<size_t>(written));
+            }
+            return true;
+        }
+#endif
+        for (const auto& frame : pending) {
+            out->write(frame->data(), static_cast<streamsize>(frame->size()));
+        }
+        out->flush();
+        pending.clear();
+        pendingBytes = 0;
+        return static_cast<bool>(*out);
+    }
+};
+
+// Fans encoded moves out to all subscribed spectators and drops slow consumers.
+// With listen() viewers connect to a Unix-domain socket, e.g. nc -U PATH.
+class SpectatorHub {
+private:
+    vector<shared_ptr<Spectator>> subscribers;
+    int listenFd = -1;
+    string socketPath;
+
+public:
+    SpectatorHub() = default;
+    SpectatorHub(const SpectatorHub&) = delete;
+    SpectatorHub& operator=(const SpectatorHub&) = delete;
+
+    ~SpectatorHub() {
+#ifdef TTT_HAVE_SOCKETS
+        if (listenFd >= 0) {
+            close(listenFd);
+            unlink(socketPath.c_str());
+        }
+#endif
+    }
+
+    void subscribe(shared_ptr<Spectator> spectator) {
+        subscribers.push_back(move(spectator));
+    }
+
+    // Accepts viewers on a Unix-domain socket at path from now on
+    void listen(const string& path) {
+#ifdef TTT_HAVE_SOCKETS
+        signal(SIGPIPE, SIG_IGN);
+        sockaddr_un addr = unixSocketAddress(path);
+        int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (fd < 0) throw runtime_error(string("socket failed: ") + strerror(errno));
+        unlink(path.c_str());
+        if (::bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0 || ::listen(fd, 64) < 0) {
+            string reason = strerror(errno);
+            close(fd);
+            throw runtime_error("Cannot listen on " + path + ": " + reason);
+        }
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+        listenFd = fd;
+        socketPath = path;
+#else
+        throw runtime_error("Spectator sockets need POSIX: " + path);
+#endif
+    }
+
+    // Subscribes every viewer waiting on the socket, starting each with board
+    void acceptViewers(const Board& board) {
+#ifdef TTT_HAVE_SOCKETS
+        if (listenFd < 0) return;
+        MoveFrame welcome;
+        for (int fd; (fd = accept(listenFd, nullptr, nullptr)) >= 0;) {
+            if (!welcome) welcome = encodeBoard(board);
+            auto viewer = make_shared<Spectator>(fd);
+            viewer->enqueue(welcome);
+            subscribe(viewer);
+        }
+#else
+        (void)board;
+#endif
+    }
+
+    bool empty() const { return subscribers.empty(); }
+    size_t count() const { return subscribers.size(); }
+
+    static MoveFrame encodeBoard(const Board& board) {
+        ostringstream frame;
+        frame << "board";
+        board.display(frame);
+        return make_shared<const string>(frame.str());
+    }
+
+    // Renders the move and resulting board a single time for all viewers
+    static MoveFrame encodeMove(const Board& board, int move, char symbol) {
+        ostringstream frame;
+        frame << "move " << symbol << " " << move;
+        board.display(frame);
+        return make_shared<const string>(frame.str());
+    }
+
+    static MoveFrame encodeText(const string& text) {
+        return make_shared<const string>(text + "\n");
+    }
+
+    // Queues frame for every viewer and returns the number dropped for falling behind
+    size_t broadcast(const MoveFrame& frame) {
+        size_t before = subscribers.size();
+        subscribers.erase(
+            remove_if(subscribers.begin(), subscribers.end(),
+                      [&](const shared_ptr<Spectator>& s) { return !s->enqueue(frame); }),
+            subscribers.end());
+        return before - subscribers.size();
+    }
+
+    // Drains every viewer's queue without blocking and drops those that went away
+    void flush() {
+        subscribers.erase(
+            remove_if(subscribers.begin(), subscribers.end(),
+                      [](const shared_ptr<Spectator>& s) { return !s->flush(); }),
+            subscribers.end());
+    }
+};
+
+// Game class
+class Game {
+private:
+    static constexpr char SNAPSHOT_MAGIC[8] = {'T', 'T', 'T', 'S', 'N', 'A', 'P', '4'};
+
+    Board board;
+    HumanPlayer human;
+    AIPlayer ai;
+    SpectatorHub spectators;
+    char toMove = '\0';  // '\0' until the first player has been drawn
+    string snapshotPath;
+    double humanClockMs = 0;  // both clocks are 0 in untimed games
+    double aiClockMs = 0;
+
+    // Header is magic, size, side to move, cells and the two clocks (human, AI),
+    // padded so the cache dump is aligned
+    static size_t cacheOffset(int boardSize) {
+        size_t headerBytes = sizeof(SNAPSHOT_MAGIC) + 2 + boardSize * boardSize + 2 * sizeof(double);
+        return (headerBytes + 7) / 8 * 8;
+    }
+
+    void announceResult(char result, bool boardFull) const {
+        if (result == ai.getSymbol()) {
+            cout << "AI Wins!" << endl;
+        } else if (result == human.getSymbol()) {
+            cout << "You Win!" << endl;
+        } else {
+            cout << (boardFull ? "It's a Draw! Game Over." : "It's a Draw!") << endl;
+        }
+    }
+
+public:
+    Game(int boardSize, const EngineConfig& config = EngineConfig()) 
+        : board(boardSize), human('O'), ai('X', 'O', boardSize, config) {}
+
+    // Lets viewers watch the game by connecting to a Unix-domain socket at path
+    void setSpectatorSocket(const string& path) { spectators.listen(path); }
+
+    // Gives each side seconds for the whole game; running out loses
+    void setClock(double seconds) {
+        humanClockMs = aiClockMs = seconds * 1000;
+    }
+
+    bool isTimed() const { return aiClockMs > 0; }
+
+    // When set, the game is written to path after every move and removed when it ends
+    void setSnapshotPath(const string& path) { snapshotPath = path; }
+
+    // Writes board, side to move, clocks and the AI's evaluation cache in one
+    // sequential pass. A shared cache is left out: it outlives the game in its
+    // segment anyway, and a restored engine would not adopt it. The file is replaced atomically so a crash never leaves half a snapshot.
+    void saveSnapshot(const string& path) const {
+        string tmpPath = path + ".tmp";
+        {
+            ofstream out(tmpPath, ios::binary | ios::trunc);
+            if (!out) throw runtime_error("Cannot write snapshot " + tmpPath);
+            int n = board.getSize();
+            vector<char> record(SNAPSHOT_MAGIC, SNAPSHOT_MAGIC + sizeof(SNAPSHOT_MAGIC));
+            record.push_back(static_cast<char>(n));
+            record.push_back(toMove);
+            for (int i = 0; i < n * n; i++) record.push_back(board.get(i));
+            for (double clockMs : {humanClockMs, aiClockMs}) {
+                const char* bytes = reinterpret_cast<const char*>(&clockMs);
+                record.insert(record.end(), bytes, bytes + sizeof(clockMs));
+            }
+            record.resize(cacheOffset(n), '\0');
+            out.write(record.data(), static_cast<streamsize>(record.size()));
+            if (!ai.getEngine().usesSharedCache()) ai.getEngine().getEvalCache().write(out);
+            if (!out) throw runtime_error("Cannot write snapshot " + tmpPath);
+        }
+        if (rename(tmpPath.c_str(), path.c_str()) != 0) {
+            remove(path.c_str());
+            if (rename(tmpPath.c_str(), path.c_str()) != 0) {
+                throw runtime_error("Cannot replace snapshot " + path);
+            }
+        }
+    }
+
+    // Returns nullptr when there is no snapshot at path; throws on a corrupt one
+    static unique_ptr<Game> restoreSnapshot(const string& path,
+                                            const EngineConfig& config = EngineConfig()) {
+        ifstream in(path, ios::binary);
+        if (!in) return nullptr;
+
+        char magic[sizeof(SNAPSHOT_MAGIC)];
+        char header[2];
+        if (!in.read(magic, sizeof(magic)) || !equal(magic, magic + sizeof(magic), SNAPSHOT_MAGIC) ||
+            !in.read(header, sizeof(header))) {
+            throw runtime_error("Not a game snapshot: " + path);
+        }
+        auto game = make_unique<Game>(header[0], config);
+        int n = game->board.getSize();
+        vector<char> cells(n * n);
+        double clocks[2];
+        if (!in.read(cells.data(), static_cast<streamsize>(cells.size())) ||
+            !in.read(reinterpret_cast<char*>(clocks), sizeof(clocks))) {
+            throw runtime_error("Truncated game snapshot: " + path);
+        }
+        // Either side may start, so the counts differ by at most one and the side
+        // with more marks cannot be the one to move; a finished game is never saved
+        int xCount = static_cast<int>(count(cells.begin(), cells.end(), 'X'));
+        int oCount = static_cast<int>(count(cells.begin(), cells.end(), 'O'));
+        char toMove = header[1];
+        bool valid = xCount + oCount + count(cells.begin(), cells.end(), Board::EMPTY) == n * n &&
+                     abs(xCount - oCount) <= 1 && (toMove == 'X' || toMove == 'O') &&
+                     !(toMove == 'X' && xCount > oCount) && !(toMove == 'O' && oCount > xCount) &&
+                     // Both clocks run or neither does; a flag fall ends the game
+                     ((clocks[0] == 0 && clocks[1] == 0) ||
+                      (isfinite(clocks[0]) && isfinite(clocks[1]) && clocks[0] > 0 && clocks[1] > 0));
+        if (!valid) throw runtime_error("Corrupt game snapshot: " + path);
+        for (int i = 0; i < n * n; i++) {
+            if (cells[i] != Board::EMPTY) game->board.set(i, cells[i]);
+        }
+        if (game->board.checkWinner() != '\0') throw runtime_error("Corrupt game snapshot: " + path);
+        game->toMove = toMove;
+        game->humanClockMs = clocks[0];
+        game->aiClockMs = clocks[1];
+        // The cache can be large; play starts while it is still being mapped in. The
+        // file is opened here, before the first save can rename a new one over path.
+        // Snapshots of games on a shared cache end after the header.
+        in.seekg(0, ios::end);
+        if (!game->ai.getEngine().usesSharedCache() && in.tellg() > static_cast<streamoff>(cacheOffset(n))) {
+            game->ai.getEngine().loadEvalCacheAsync(OpenFile(path), cacheOffset(n));
+        }
+        return game;
+    }
+
+    void play() {
+        cout << "Welcome to " << board.getSize() << "x" << board.getSize() 
+             << " Tic-Tac-Toe!" << endl;
+        cout << "You are '" << human.getSymbol() << "', AI is '" 
+             << ai.getSymbol() << "'" << endl;
+        board.display();
+
+        Player* currentPlayer;
+        if (toMove != '\0') {
+            currentPlayer = (toMove == human.getSymbol()) ?
+                static_cast<Player*>(&human) : static_cast<Player*>(&ai);
+            cout << "\n>> Resuming saved game, " << toMove << " to move." << endl;
+        } else {
+            // Randomly choose who starts first
+            srand(static_cast<unsigned>(time(nullptr)));
+            currentPlayer = (rand() % 2 == 0) ? 
+                static_cast<Player*>(&human) : static_cast<Player*>(&ai);
+            
+            if (currentPlayer == &human) {
+                cout << "\n>> You go first!" << endl;
+            } else {
+                cout << "\n>> AI goes first!" << endl;
+            }
+        }
+
+        while (true) {
+            if (board.isFull()) {
+                announceResult(board.checkWinner(), true);
+                break;
+            }
+
+            bool timed = aiClockMs > 0;
+            auto moveStart = chrono::steady_clock::now();
+            if (timed) ai.setTimeLeft(aiClockMs);
+            int move = currentPlayer->getMove(board);
+            if (timed) {
+                double& clockMs = (currentPlayer == &human) ? humanClockMs : aiClockMs;
+                clockMs -= chrono::duration<double, milli>(chrono::steady_clock::now() - moveStart).count();
+                if (clockMs <= 0) {
+                    cout << (currentPlayer == &human ? "You ran out of time! AI Wins!"
+                                                     : "AI ran out of time! You Win!") << endl;
+                    break;
+                }
+                cout << fixed << setprecision(1) << "Clock: You " << humanClockMs / 1000 
+                     << "s, AI " << aiClockMs / 1000 << "s" << defaultfloat << endl;
+            }
+            // Viewers that connected during the move are welcomed with the board as
+            // it was, so the move frame that follows is news to them too.
+            spectators.acceptViewers(board);
+            board.set(move, currentPlayer->getSymbol());
+            TTT_PROBE2(move_played, currentPlayer->getSymbol(), move);
+            board.display();
+            if (!spectators.empty()) {
+                spectators.broadcast(SpectatorHub::encodeMove(board, move, currentPlayer->getSymbol()));
+                spectators.flush();
+            }
+
+            char winner = board.checkWinner();
+            if (winner != '\0') {
+                announceResult(winner, false);
+                break;
+            }
+
+            // Switch player
+            currentPlayer = (currentPlayer == &human) ? 
+                static_cast<Player*>(&ai) : static_cast<Player*>(&human);
+            toMove = currentPlayer->getSymbol();
+            if (!snapshotPath.empty()) saveSnapshot(snapshotPath);
+        }
+
+        spectators.acceptViewers(board);
+        spectators.broadcast(SpectatorHub::encodeText("game over"));
+        spectators.flush();
+        if (!snapshotPath.empty()) remove(snapshotPath.c_str());
+    }
+};
+
+// Perfect hash of positions with consistent mark counts (X and O differ by at most
+// one, since either side may start). Positions are grouped by (marks, X count);
+// within a group the X cells are ranked among all cells and the O cells among the
+// cells X left free, both in colexicographic order. rank() maps every such
+// position to a unique index in [0, count()) and unrank() inverts it, so
+// per-position data fits a dense array indexed directly by rank.
+class PositionIndexer {
+private:
+    static const int N_MAX = Board::MAX_CELLS;
+    static const uint64_t NO_GROUP = ~uint64_t(0);
+
+    int size;
+    int cellCount;
+    uint64_t binomial[N_MAX + 1][N_MAX + 1];
+    uint64_t groupOffset[N_MAX + 1][N_MAX + 1];  // [xCount][oCount]
+    vector<pair<int, int>> groups;               // (xCount, oCount) in index order
+    uint64_t total;
+    int symmetry[8][N_MAX];                      // cell -> cell for each board symmetry
+    vector<uint32_t> classOf;                    // rank -> symmetry class, once built
+    uint64_t classes = 0;
+
+    static void marksOf(const Board& board, uint64_t& xMarks, uint64_t& oMarks) {
+        xMarks = oMarks = 0;
+        for (int i = 0; i < board.getSize() * board.getSize(); i++) {
+            if (board.get(i) == 'X') xMarks |= uint64_t(1) << i;
+            else if (board.get(i) == 'O') oMarks |= uint64_t(1) << i;
+        }
+    }
+
+    // Colexicographic rank of the set bits of bits
+    uint64_t rankSet(uint64_t bits) const {
+        uint64_t r = 0;
+        for (int k = 1; bits; k++) {
+            r += binomial[lowestBitIndex(bits)][k];
+            bits &= bits - 1;
+        }
+        return r;
+    }
+
+    uint64_t unrankSet(uint64_t r, int k) const {
+        uint64_t bits = 0;
+        int c = cellCount - 1;
+        for (; k > 0; k--) {
+            while (binomial[c][k] > r) c--;
+            r -= binomial[c][k];
+            bits |= uint64_t(1) << c;
+            c--;
+        }
+        return bits;
+    }
+
+    // Squeezes out the cells of taken, so the free cells are numbered 0, 1, 2, ...
+    uint64_t compress(uint64_t bits, uint64_t taken) const {
+#ifdef __BMI2__
+        return _pext_u64(bits, ~taken);
+#else
+        // A free cell's new number is its own less the taken cells below it
+        uint64_t out = 0;
+        for (bits &= ~taken; bits; bits &= bits - 1) {
+            int c = lowestBitIndex(bits);
+            out |= uint64_t(1) << (c - popCount64(taken & ((uint64_t(1) << c) - 1)));
+        }
+        return out;
+#endif
+    }
+
+    uint64_t expand(uint64_t bits, uint64_t taken) const {
+#ifdef __BMI2__
+        return _pdep_u64(bits, ~taken);
+#else
+        uint64_t out = 0;
+        int j = 0;
+        for (int c = 0; c < cellCount; c++) {
+            if (taken >> c & 1) continue;
+            if (bits >> j & 1) out |= uint64_t(1) << c;
+            j++;
+        }
+        return out;
+#endif
+    }
+
+    uint64_t transform(uint64_t bits, int s) const {
+        uint64_t out = 0;
+        for (; bits; bits &= bits - 1) out |= uint64_t(1) << symmetry[s][lowestBitIndex(bits)];
+        return out;
+    }
+
+    // Next set with the same number of bits in colexicographic order (Gosper's hack)
+    static uint64_t nextSubset(uint64_t bits) {
+        uint64_t low = bits & (~bits + 1);
+        uint64_t ripple = bits + low;
+        return ripple | (((bits ^ ripple) >> 2) / low);
+    }
+
+public:
+    explicit PositionIndexer(int boardSize) : size(boardSize), cellCount(boardSize * boardSize) {
+        Board check(boardSize);  // validates the size
+
+        for (int n = 0; n <= N_MAX; n++) {
+            for (int k = 0; k <= N_MAX; k++) {
+                binomial[n][k] = (k == 0) ? 1 : (n == 0) ? 0
+                    : binomial[n - 1][k - 1] + binomial[n - 1][k];
+            }
+        }
+
+        total = 0;
+        for (int x = 0; x <= N_MAX; x++) {
+            for (int o = 0; o <= N_MAX; o++) groupOffset[x][o] = NO_GROUP;
+        }
+        for (int marks = 0; marks <= cellCount; marks++) {
+            for (int x = marks / 2; x <= (marks + 1) / 2; x++) {
+                int o = marks - x;
+                if (groupOffset[x][o] != NO_GROUP) continue;
+                groupOffset[x][o] = total;
+                groups.emplace_back(x, o);
+                total += binomial[cellCount][x] * binomial[cellCount - x][o];
+            }
+        }
+
+        // Rotations and their mirror images
+        for (int c = 0; c < cellCount; c++) {
+            int r = c / size, col = c % size, m = size - 1;
+            int coords[8][2] = {{r, col}, {col, m - r}, {m - r, m - col}, {m - col, r},
+                                {r, m - col}, {col, r}, {m - r, col}, {m - col, m - r}};
+            for (int s = 0; s < 8; s++) symmetry[s][c] = coords[s][0] * size + coords[s][1];
+        }
+    }
+
+    // Number of indexable positions, i.e. the length of a dense per-position array
+    uint64_t count() const { return total; }
+
+    // Throws invalid_argument when the mark counts differ by more than one
+    uint64_t rank(uint64_t xMarks, uint64_t oMarks) const {
+        int x = popCount64(xMarks), o = popCount64(oMarks);
+        if ((xMarks & oMarks) != 0 || groupOffset[x][o] == NO_GROUP) {
+            throw invalid_argument("Position has inconsistent mark counts");
+        }
+        uint64_t xRank = rankSet(xMarks);
+        uint64_t oRank = rankSet(compress(oMarks, xMarks));
+        return groupOffset[x][o] + xRank * binomial[cellCount - x][o] + oRank;
+    }
+
+    uint64_t rank(const Board& board) const {
+        uint64_t xMarks, oMarks;
+        marksOf(board, xMarks, oMarks);
+        return rank(xMarks, oMarks);
+    }
+
+    void unrank(uint64_t index, uint64_t& xMarks, uint64_t& oMarks) const {
+        if (index >= total) throw out_of_range("Position index out of range");
+        auto group = upper_bound(groups.begin(), groups.end(), index,
+            [this](uint64_t i, const pair<int, int>& g) { return i < groupOffset[g.first][g.second]; });
+        int x = (group - 1)->first, o = (group - 1)->second;
+        uint64_t local = index - groupOffset[x][o];
+        uint64_t oWays = binomial[cellCount - x][o];
+        xMarks = unrankSet(local / oWays, x);
+        oMarks = expand(unrankSet(local % oWays, o), xMarks);
+    }
+
+    Board unrank(uint64_t index) const {
+        uint64_t xMarks, oMarks;
+        unrank(index, xMarks, oMarks);
+        Board board(size);
+        for (int i = 0; i < cellCount; i++) {
+            if (xMarks >> i & 1) board.set(i, 'X');
+            else if (oMarks >> i & 1) board.set(i, 'O');
+        }
+        return board;
+    }
+
+    // Smallest rank among the eight rotations and reflections of the position, so
+    // symmetric positions share one index. The canonical ranks are a sparse subset
+    // of [0, count()); classIndex() numbers them densely.
+    uint64_t canonicalRank(uint64_t xMarks, uint64_t oMarks) const {
+        uint64_t best = rank(xMarks, oMarks);
+        for (int s = 1; s < 8; s++) {
+            best = min(best, rank(transform(xMarks, s), transform(oMarks, s)));
+        }
+        return best;
+    }
+
+    uint64_t canonicalRank(const Board& board) const {
+        uint64_t xMarks, oMarks;
+        marksOf(board, xMarks, oMarks);
+        return canonicalRank(xMarks, oMarks);
+    }
+
+    // Largest count() buildClassTable() takes on, at four bytes per position
+    static const uint64_t MAX_CLASS_TABLE = uint64_t(1) << 26;
+
+    // Numbers the symmetry classes in order of their canonical rank and records
+    // the class of every rank. Each position's canonical rank is no larger than
+    // its own, so one pass in rank order sees every class's first member first;
+    // the pass steps through the subsets directly instead of unranking each index.
+    // Returns false, building nothing, when count() exceeds MAX_CLASS_TABLE.
+    bool buildClassTable() {
+        if (total > MAX_CLASS_TABLE) return false;
+        classOf.assign(total, 0);
+        classes = 0;
+        uint64_t r = 0;
+        for (const auto& group : groups) {
+            int x = group.first, o = group.second;
+            uint64_t xMarks = (uint64_t(1) << x) - 1;
+            for (uint64_t xi = 0; xi < binomial[cellCount][x]; xi++) {
+                uint64_t oFree = (uint64_t(1) << o) - 1;
+                for (uint64_t oi = 0; oi < binomial[cellCount - x][o]; oi++, r++) {
+                    uint64_t canonical = canonicalRank(xMarks, expand(oFree, xMarks));
+                    classOf[r] = canonical == r ? static_cast<uint32_t>(classes++) : classOf[canonical];
+                    if (o > 0) oFree = nextSubset(oFree);
+                }
+                if (x > 0) xMarks = nextSubset(xMarks);
+            }
+        }
+        return true;
+    }
+
+    // Number of symmetry classes; 0 until buildClassTable() has run
+    uint64_t classCount() const { return classes; }
+
+    // Dense index in [0, classCount()) shared by the position and its rotations
+    // and reflections. Throws logic_error if the class table has not been built.
+    uint32_t classIndex(uint64_t xMarks, uint64_t oMarks) const {
+        if (classOf.empty()) throw logic_error("Symmetry class table has not been built");
+        return classOf[rank(xMarks, oMarks)];
+    }
+
+    uint32_t classIndex(const Board& board) const {
+        uint64_t xMarks, oMarks;
+        marksOf(board, xMarks, oMarks);
+        return classIndex(xMarks, oMarks);
+    }
+};
+
+// Samples legal, non-terminal positions uniformly for a given number of filled
+// cells: mark counts differ by at most one (either side may have started) and no
+// line is complete. Positions are drawn as bitboards on several threads and
+// deduplicated by Zobrist key before being written in compact notation.
+class PositionGenerator {
+private:
+    int size;
+    int filled;
+    vector<uint64_t> winMasks;
+    vector<uint64_t> xKeys, oKeys;  // Zobrist contribution of a mark on each cell
+
+    static const int SHARDS = 64;
+    mutex shardLocks[SHARDS];
+    unordered_set<uint64_t> seen[SHARDS];
+
+    // xorshift64*: small and fast enough that sampling is not RNG-bound
+    static uint64_t nextRandom(uint64_t& state) {
+        state ^= state >> 12;
+        state ^= state << 25;
+        state ^= state >> 27;
+        return state * 0x2545F4914F6CDD1DULL;
+    }
+
+    // Modulo bias is below 2^-58 for bounds up to 36 cells
+    static uint64_t below(uint64_t& state, uint64_t bound) {
+        return nextRandom(state) % bound;
+    }
+
+    bool hasWinner(uint64_t marks) const {
+        for (uint64_t mask : winMasks) {
+            if ((marks & mask) == mask) return true;
+        }
+        return false;
+    }
+
+    bool insertUnique(uint64_t key) {
+        int shard = static_cast<int>(key >> 58) % SHARDS;
+        lock_guard<mutex> lock(shardLocks[shard]);
+        return seen[shard].insert(key).second;
+    }
+
+public:
+    PositionGenerator(int boardSize, int filledCells)
+        : size(boardSize), filled(filledCells), winMasks(Board(boardSize).getWinMasks()) {
+        if (filled < 0 || filled >= size * size) {
+            throw invalid_argument("Filled cells must be between 0 and " + to_string(size * size - 1));
+        }
+        Board board(size);
+        for (int i = 0; i < size * size; i++) {
+            xKeys.push_back(board.hashAfter(i, 'X') ^ board.getHash());
+            oKeys.push_back(board.hashAfter(i, 'O') ^ board.getHash());
+        }
+    }
+
+    // Writes up to count distinct positions to out and returns how many were written.
+    // Stops early when new positions have become too rare to find.
+    size_t generate(size_t count, int threads, uint64_t seed, ostream& out) {
+        atomic<size_t> produced(0);
+        atomic<size_t> misses(0);
+        const size_t missLimit = count * 16 + 1000000;
+        mutex outLock;
+
+        auto worker = [&](int id) {
+            uint64_t state = seed + 0x9E3779B97F4A7C15ULL * (id + 1);
+            splitMix64(state);
+            int n2 = size * size;
+            int cells[Board::MAX_CELLS];
+            string buffer;
+            string line(n2 + 1, '\n');
+
+            while (produced.load(memory_order_relaxed) < count &&
+                   misses.load(memory_order_relaxed) < missLimit) {
+                // Odd fills have two legal splits of equal size; pick one at random
+                int xCount = (filled + (filled % 2 == 1 && (nextRandom(state) & 1))) / 2;
+
+                for (int i = 0; i < n2; i++) cells[i] = i;
+                uint64_t xMarks = 0, oMarks = 0;
+                for (int k = 0; k < filled; k++) {
+                    int j = k + static_cast<int>(below(state, n2 - k));
+                    swap(cells[k], cells[j]);
+                    (k < xCount ? xMarks : oMarks) |= uint64_t(1) << cells[k];
+                }
+                if (hasWinner(xMarks) || hasWinner(oMarks)) continue;
+
+                uint64_t key = 0;
+                for (int k = 0; k < filled; k++) {
+                    key ^= (k < xCount ? xKeys : oKeys)[cells[k]];
+                }
+                if (!insertUnique(key)) {
+                    misses.fetch_add(1, memory_order_relaxed);
+                    continue;
+                }
+                if (produced.fetch_add(1, memory_order_relaxed) >= count) break;
+                for (int i = 0; i < n2; i++) {
+                    line[i] = (xMarks >> i & 1) ? 'X' : (oMarks >> i & 1) ? 'O' : '.';
+                }
+                buffer += line;
+                if (buffer.size() >= 64 * 1024) {
+                    lock_guard<mutex> lock(outLock);
+                    out << buffer;
+                    buffer.clear();
+                }
+            }
+            lock_guard<mutex> lock(outLock);
+            out << buffer;
+        };
+
+        vector<thread> pool;
+        for (int t = 1; t < threads; t++) pool.emplace_back(worker, t);
+        worker(0);
+        for (auto& t : pool) t.join();
+        return min(produced.load(), count);
+    }
+};
+
+// Random playouts on bitboards, LANES games at a time. All lanes advance one ply
+// per step and the "did the mover just win" test runs over the lanes together:
+// with AVX2 as two 4x64-bit compares per win line, otherwise as a plain loop.
+// A finished lane immediately restarts from the start position until the
+// requested number of playouts has been started.
+class PlayoutKernel {
+public:
+    static const int LANES = 8;
+
+    struct Result {
+        uint64_t xWins = 0;
+        uint64_t oWins = 0;
+        uint64_t draws = 0;
+
+        uint64_t total() const { return xWins + oWins + draws; }
+    };
+
+    static const char* kernelName() {
+#ifdef __AVX2__
+        return "avx2";
+#else
+        return "scalar";
+#endif
+    }
+
+private:
+    uint64_t fullMask;
+    vector<uint64_t> winMasks;
+
+    // won[l] becomes all ones when marks[l] covers a complete line
+    void testWins(const uint64_t* marks, uint64_t* won) const {
+#ifdef __AVX2__
+        __m256i lo = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(marks));
+        __m256i hi = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(marks + 4));
+        __m256i wonLo = _mm256_setzero_si256();
+        __m256i wonHi = _mm256_setzero_si256();
+        for (uint64_t mask : winMasks) {
+            __m256i line = _mm256_set1_epi64x(static_cast<long long>(mask));
+            wonLo = _mm256_or_si256(wonLo, _mm256_cmpeq_epi64(_mm256_and_si256(lo, line), line));
+            wonHi = _mm256_or_si256(wonHi, _mm256_cmpeq_epi64(_mm256_and_si256(hi, line), line));
+        }
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(won), wonLo);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(won + 4), wonHi);
+#else
+        for (int l = 0; l < LANES; l++) won[l] = 0;
+        for (uint64_t mask : winMasks) {
+            for (int l = 0; l < LANES; l++) {
+                won[l] |= ((marks[l] & mask) == mask) ? ~uint64_t(0) : 0;
+            }
+        }
+#endif
+    }
+
+public:
+    explicit PlayoutKernel(int boardSize) {
+        Board board(boardSize);
+        winMasks = board.getWinMasks();
+        int cells = boardSize * boardSize;
+        fullMask = (cells == 64) ? ~uint64_t(0) : (uint64_t(1) << cells) - 1;
+    }
+
+    // Plays random games from start with toMove to play; start must not be decided
+    Result run(const Board& start, char toMove, uint64_t playouts, uint64_t seed) const {
+        uint64_t startX = 0, startO = 0;
+        for (int i = 0; i < start.getSize() * start.getSize(); i++) {
+            if (start.get(i) == 'X') startX |= uint64_t(1) << i;
+            else if (start.get(i) == 'O') startO |= uint64_t(1) << i;
+        }
+
+        uint64_t x[LANES], o[LANES], movers[LANES], won[LANES];
+        bool xToMove[LANES], active[LANES];
+        uint64_t started = 0;
+        for (int l = 0; l < LANES; l++) {
+            active[l] = started < playouts;
+            if (active[l]) started++;
+            x[l] = startX;
+            o[l] = startO;
+            xToMove[l] = toMove == 'X';
+        }
+
+        uint64_t state = seed | 1;
+        Result result;
+        int activeLanes = static_cast<int>(started);
+        while (activeLanes > 0) {
+            for (int l = 0; l < LANES; l++) {
+                uint64_t empty = fullMask & ~(x[l] | o[l]);
+                if (!active[l] || empty == 0) {
+                    movers[l] = 0;
+                    continue;
+                }
+                state ^= state >> 12;
+                state ^= state << 25;
+                state ^= state >> 27;
+                uint64_t pick = (state * 0x2545F4914F6CDD1DULL) >> 32;
+                uint64_t bit = selectBit(empty, static_cast<int>(pick % popCount64(empty)));
+                uint64_t& marks = xToMove[l] ? x[l] : o[l];
+                marks |= bit;
+                movers[l] = marks;
+            }
+
+            testWins(movers, won);
+
+            for (int l = 0; l < LANES; l++) {
+                if (!active[l]) continue;
+                bool full = ((x[l] | o[l]) & fullMask) == fullMask;
+                if (won[l] == 0 && !full) {
+                    xToMove[l] = !xToMove[l];
+                    continue;
+                }
+                if (won[l] != 0) (xToMove[l] ? result.xWins : result.oWins)++;
+                else result.draws++;
+                x[l] = startX;
+                o[l] = startO;
+                xToMove[l] = toMove == 'X';
+                if (started < playouts) {
+                    started++;
+                } else {
+                    active[l] = false;
+                    activeLanes--;
+                }
+            }
+        }
+        return result;
+    }
+};
+
+// One training example: a position, the searcher's verdict and the final outcome.
+// Fixed size and layout so shards can be read back as flat arrays.
+struct TrainingRecord {
+    uint8_t size;
+    uint8_t toMove;     // 'X' or 'O'
+    int8_t bestMove;
+    int8_t result;      // 1 side to move went on to win, 0 draw, -1 loss
+    int32_t score;      // search score from the side to move's view
+    uint8_t cells[Board::MAX_CELLS];  // 0 empty, 1 X, 2 O; unused cells 0
+};
+static_assert(sizeof(TrainingRecord) == 44, "TrainingRecord layout is part of the file format");
+
+// Plays self-play games on one thread with several in flight. Each lane has its
+// own board and pair of engines, and all engines share one evaluation cache.
+// With more than one lane the searches are interleaved: a search that needs a
+// cache slot prefetches it and yields, and the next lane runs while the line
+// loads. Games are numbered within the series started by a seed; the same seed
+// and index always give the same game, whichever lane, thread or process plays it.
+class SelfPlayLanes {
+private:
+    struct Lane {
+        unique_ptr<AIEngine> xEngine;
+        unique_ptr<AIEngine> oEngine;
+        Board board;
+        uint64_t state = 0;
+        char turn = 'X';
+        int ply = 0;
+        bool active = false;
+        bool searching = false;
+        vector<TrainingRecord> game;
+
+        explicit Lane(int size) : board(size) {}
+        AIEngine& engine() { return turn == 'X' ? *xEngine : *oEngine; }
+    };
+
+    int size;
+    vector<Lane> lanes;
+
+    void startGame(Lane& lane, uint64_t seed, uint64_t index) {
+        lane.state = seed ^ (0x9E3779B97F4A7C15ULL * (index + 1));
+        lane.board = Board(size);
+        lane.xEngine->newGame();
+        lane.oEngine->newGame();
+        lane.game.clear();
+        lane.turn = (splitMix64(lane.state) & 1) ? 'X' : 'O';
+        lane.ply = 0;
+        lane.active = true;
+        lane.searching = false;
+    }
+
+    void play(Lane& lane, int move) {
+        lane.board.set(move, lane.turn);
+        lane.turn = (lane.turn == 'X') ? 'O' : 'X';
+        lane.ply++;
+    }
+
+public:
+    SelfPlayLanes(int boardSize, int depth, int laneCount, shared_ptr<EvalCache> cache) : size(boardSize) {
+        for (int l = 0; l < max(1, laneCount); l++) {
+            lanes.emplace_back(boardSize);
+            lanes.back().xEngine.reset(new AIEngine('X', 'O', depth, cache));
+            lanes.back().oEngine.reset(new AIEngine('O', 'X', depth, cache));
+        }
+    }
+
+    // Plays games while nextGame(index) hands out indices; onGame(winner, records)
+    // receives each finished game, in the order the games end
+    template <class NextGame, class OnGame>
+    void run(uint64_t seed, NextGame nextGame, OnGame onGame) {
+        // Random opening plies so games from different seeds diverge
+        int openingPlies = min(4, size * size / 4);
+        bool interleave = lanes.size() > 1;
+        uint64_t index;
+        for (auto& lane : lanes) {
+            if (nextGame(index)) startGame(lane, seed, index);
+        }
+
+        for (bool busy = true; busy;) {
+            busy = false;
+            for (auto& lane : lanes) {
+                if (!lane.active) continue;
+                busy = true;
+                if (lane.searching) {
+                    AIEngine& engine = lane.engine();
+                    if (!engine.resumeSearch(interleave)) continue;
+                    lane.searching = false;
+                    int move = engine.finishSearch();
+                    TrainingRecord record = {};
+                    record.size = static_cast<uint8_t>(size);
+                    record.toMove = static_cast<uint8_t>(lane.turn);
+                    record.bestMove = static_cast<int8_t>(move);
+                    record.score = engine.getLastScore();
+                    for (int i = 0; i < size * size; i++) {
+                        char c = lane.board.get(i);
+                        record.cells[i] = c == 'X' ? 1 : c == 'O' ? 2 : 0;
+                    }
+                    lane.game.push_back(record);
+                    play(lane, move);
+                }
+
+                // Play on until the lane's next search has started or its game is over
+                char winner;
+                while ((winner = lane.board.checkWinner()) == '\0' && lane.ply < openingPlies) {
+                    vector<int> empty = lane.board.getEmptyCells();
+                    play(lane, empty[splitMix64(lane.state) % empty.size()]);
+                }
+                if (winner == '\0') {
+                    lane.engine().startSearch(lane.board);
+                    lane.searching = true;
+                    continue;
+                }
+                for (auto& record : lane.game) {
+                    record.result = winner == 'D' ? 0 : (winner == record.toMove ? 1 : -1);
+                }
+                onGame(winner, lane.game);
+                lane.active = false;
+                if (nextGame(index)) startGame(lane, seed, index);
+            }
+        }
+    }
+};
+
+// Plays AI-vs-AI games and exports every searched position as a TrainingRecord.
+// Each thread buffers its records and writes its own series of shard files,
+// prefix-t<thread>-<shard>.bin, rolling over every recordsPerShard records, so
+// workers never contend for a file or a lock.
+class SelfPlayExporter {
+private:
+    int size;
+    EngineConfig config;
+    string prefix;
+    size_t recordsPerShard;
+
+public:
+    static const size_t BUFFER_RECORDS = 4096;
+
+    // Series of shard files for one writer; thread < 0 leaves out the -t<thread> tag
+    struct ShardWriter {
+        string prefix;
+        int thread;
+        size_t perShard;
+        size_t inShard = 0;
+        int shard = 0;
+        ofstream file;
+        vector<TrainingRecord> buffer;
+
+        ShardWriter(const string& filePrefix, int threadId, size_t shardRecords)
+            : prefix(filePrefix), thread(threadId), perShard(shardRecords) {}
+
+        void open() {
+            ostringstream name;
+            name << prefix;
+            if (thread >= 0) name << "-t" << thread;
+            name << "-" << setw(5) << setfill('0') << shard++ << ".bin";
+            file.close();
+            file.open(name.str(), ios::binary | ios::trunc);
+            if (!file) throw runtime_error("Cannot write " + name.str());
+            inShard = 0;
+        }
+
+        void flush() {
+            size_t done = 0;
+            while (done < buffer.size()) {
+                if (!file.is_open() || inShard == perShard) open();
+                size_t chunk = min(buffer.size() - done, perShard - inShard);
+                file.write(reinterpret_cast<const char*>(buffer.data() + done),
+                           static_cast<streamsize>(chunk * sizeof(TrainingRecord)));
+                inShard += chunk;
+                done += chunk;
+            }
+            buffer.clear();
+        }
+    };
+
+    struct Totals {
+        size_t games = 0;
+        size_t records = 0;
+        size_t wins[3] = {0, 0, 0};  // X, O, draw
+    };
+
+    SelfPlayExporter(int boardSize, const EngineConfig& engineConfig, const string& filePrefix,
+                     size_t shardRecords = size_t(1) << 20)
+        : size(boardSize), config(engineConfig), prefix(filePrefix), recordsPerShard(shardRecords) {
+        Board check(boardSize);  // validates the size
+    }
+
+    Totals run(size_t games, uint64_t seed) {
+        int threads = max(1, config.threads);
+        vector<Totals> perThread(threads);
+        atomic<size_t> nextGame(0);
+        mutex errorLock;
+        string error;
+        // Each thread runs an X and an O engine per lane over one cache
+        EngineConfig share = config.forWorkers(threads, 2 * max(1, config.interleave), threads - 1);
+
+        auto worker = [&](int id) {
+            try {
+                auto cache = make_shared<EvalCache>(share.sharedCacheName.empty()
+                    ? EvalCache(share.evalCacheEntries())
+                    : EvalCache::openShared(share.sharedCacheName, share.evalCacheEntries()));
+                SelfPlayLanes lanes(size, AIPlayer::depthFor(size, config), config.interleave, cache);
+                ShardWriter writer(prefix, id, recordsPerShard);
+                Totals& totals = perThread[id];
+
+                lanes.run(seed, [&](uint64_t& g) { return (g = nextGame.fetch_add(1)) < games; },
+                          [&](char winner, const vector<TrainingRecord>& game) {
+                    writer.buffer.insert(writer.buffer.end(), game.begin(), game.end());
+                    if (writer.buffer.size() >= BUFFER_RECORDS) writer.flush();
+                    totals.games++;
+                    totals.records += game.size();
+                    totals.wins[winner == 'X' ? 0 : winner == 'O' ? 1 : 2]++;
+                });
+                writer.flush();
+            } catch (const exception& e) {
+                lock_guard<mutex> lock(errorLock);
+                error = e.what();
+                nextGame = games;
+            }
+        };
+
+        vector<thread> pool;
+        for (int t = 1; t < threads; t++) pool.emplace_back(worker, t);
+        worker(0);
+        for (auto& t : pool) t.join();
+        if (!error.empty()) throw runtime_error(error);
+
+        Totals totals;
+        for (const auto& t : perThread) {
+            totals.games += t.games;
+            totals.records += t.records;
+            for (int k = 0; k < 3; k++) totals.wins[k] += t.wins[k];
+        }
+        return totals;
+    }
+};
+
+#ifdef TTT_HAVE_SOCKETS
+// Self-play across worker processes. The coordinator listens on a Unix-domain
+// socket and hands out batches of game indices, with the engine settings, to
+// every worker that connects; the records the workers stream back are merged
+// into one series of shards. A batch's records are written only once its worker
+// reports it done, so when a worker dies mid-batch the batch is re-queued and
+// its games are played again without duplicates. Workers are started locally
+// by the coordinator or by hand with --worker SOCKET, e.g. on other hosts
+// through a forwarded socket.
+class SelfPlayCoordinator {
+public:
+    // Work order for one batch
+    struct BatchSpec {
+        uint32_t id;
+        int32_t size;
+        int32_t depth;
+        uint32_t count;
+        uint64_t seed;
+        uint64_t firstGame;
+        uint64_t memoryBudget;
+        uint64_t evalCacheSize;     // calibrated slot count, used without a budget
+        int32_t interleave;
+        int32_t reserved;
+        char sharedCacheName[64];   // NUL-terminated; empty keeps each cache private
+    };
+
+    // A worker's report for a finished batch
+    struct BatchDone {
+        uint32_t id;
+        uint32_t games;
+        uint32_t wins[3];  // X, O, draw
+    };
+
+    static const uint32_t GAMES_PER_BATCH = 16;
+
+private:
+    enum MessageType : uint32_t { MSG_BATCH = 1, MSG_RECORDS = 2, MSG_DONE = 3, MSG_STOP = 4 };
+
+    struct MessageHeader {
+        uint32_t type;
+        uint32_t length;
+    };
+
+    // The coordinator side of a worker connection. The socket is non-blocking:
+    // bytes are collected in inbox as they arrive and a message is handled only
+    // once all of it is there, so a stalled peer never holds up the others.
+    struct Connection {
+        int fd;
+        int batch;  // -1 when idle
+        pid_t pid;  // peer process, 0 when unknown
+        chrono::steady_clock::time_point assigned;
+        vector<char> inbox;
+    };
+
+    static const uint32_t MAX_MESSAGE_BYTES = 1 << 24;
+    // Replacement local workers started after crashes, per initial worker
+    static const int RESTARTS_PER_WORKER = 2;
+    // A batch is taken back from its worker after this long, or after
+    // BATCH_TIMEOUT_FACTOR times the slowest batch finished so far if that is longer
+    static constexpr int BATCH_TIMEOUT_SECONDS = 600;
+    static constexpr int BATCH_TIMEOUT_FACTOR = 4;
+
+    int size;
+    EngineConfig config;
+    string prefix;
+    string socketPath;
+
+    // On the coordinator's non-blocking sockets a peer whose receive buffer is
+    // full fails the write; the coordinator only sends small orders, so that
+    // peer has stopped reading and is dropped
+    static bool writeFully(int fd, const void* data, size_t length) {
+        const char* p = static_cast<const char*>(data);
+        while (length > 0) {
+            ssize_t n = send(fd, p, length, MSG_NOSIGNAL);
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) return false;
+            p += n;
+            length -= static_cast<size_t>(n);
+        }
+        return true;
+    }
+
+    static bool readFully(int fd, void* data, size_t length) {
+        char* p = static_cast<char*>(data);
+        while (length > 0) {
+            ssize_t n = recv(fd, p, length, 0);
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) return false;
+            p += n;
+            length -= static_cast<size_t>(n);
+        }
+        return true;
+    }
+
+    static bool sendMessage(int fd, uint32_t type, const void* data, size_t length,
+                            const void* extra = nullptr, size_t extraLength = 0) {
+        MessageHeader header = {type, static_cast<uint32_t>(length + extraLength)};
+        return writeFully(fd, &header, sizeof(header)) && writeFully(fd, data, length) &&
+               writeFully(fd, extra, extraLength);
+    }
+
+    // Appends whatever the peer has sent so far to c.inbox. False once the peer
+    // has closed the connection or it failed; bytes read before that are kept.
+    static bool receiveAvailable(Connection& c) {
+        char chunk[1 << 16];
+        while (true) {
+            ssize_t n = recv(c.fd, chunk, sizeof(chunk), 0);
+            if (n > 0) {
+                c.inbox.insert(c.inbox.end(), chunk, chunk + n);
+                continue;
+            }
+            if (n < 0 && errno == EINTR) continue;
+            return n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK);
+        }
+    }
+
+    // False when the peer has gone away or sent something malformed
+    static bool receiveMessage(int fd, uint32_t& type, vector<char>& payload) {
+        MessageHeader header;
+        if (!readFully(fd, &header, sizeof(header)) || header.length > MAX_MESSAGE_BYTES) return false;
+        type = header.type;
+        payload.resize(header.length);
+        return readFully(fd, payload.data(), payload.size());
+    }
+
+    // Starts a worker running this same binary. /proc/self/exe finds it even when
+    // it was started through PATH; where that does not exist execvp searches PATH.
+    pid_t spawnWorker(const string& program) const {
+        pid_t pid = fork();
+        if (pid < 0) throw runtime_error(string("fork failed: ") + strerror(errno));
+        if (pid == 0) {
+            const char* args[] = {program.c_str(), "--worker", socketPath.c_str(), nullptr};
+            execv("/proc/self/exe", const_cast<char* const*>(args));
+            execvp(program.c_str(), const_cast<char* const*>(args));
+            _exit(127);
+        }
+        return pid;
+    }
+
+    // Process on the other end of a local connection, so a hung local worker can
+    // be killed and replaced; 0 where the platform does not report it
+    static pid_t peerProcess(int fd) {
+#ifdef SO_PEERCRED
+        struct ucred credentials;
+        socklen_t length = sizeof(credentials);
+        if (getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &credentials, &length) == 0) return credentials.pid;
+#else
+        (void)fd;
+#endif
+        return 0;
+    }
+
+public:
+    SelfPlayCoordinator(int boardSize, const EngineConfig& engineConfig, const string& filePrefix,
+                        const string& path)
+        : size(boardSize), config(engineConfig), prefix(filePrefix), socketPath(path) {
+        Board check(boardSize);  // validates the size
+        if (config.sharedCacheName.size() >= sizeof(BatchSpec::sharedCacheName)) {
+            throw runtime_error("Shared cache name too long for workers: " + config.sharedCacheName);
+        }
+    }
+
+    // Plays games in batches on localWorkers copies of program plus any worker
+    // that connects on its own, and returns once every batch is written
+    SelfPlayExporter::Totals run(size_t games, int localWorkers, const string& program, uint64_t seed) {
+        signal(SIGPIPE, SIG_IGN);
+        sockaddr_un addr = unixSocketAddress(socketPath);
+        int listenFd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (listenFd < 0) throw runtime_error(string("socket failed: ") + strerror(errno));
+        unlink(socketPath.c_str());
+        if (bind(listenFd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0 || listen(listenFd, 64) < 0) {
+            string reason = strerror(errno);
+            close(listenFd);
+            throw runtime_error("Cannot listen on " + socketPath + ": " + reason);
+        }
+
+        // Local workers are whole processes, each with an X and an O engine per lane
+        EngineConfig share = config.forWorkers(max(1, localWorkers), 2 * max(1, config.interleave), 0);
+        vector<BatchSpec> batches;
+        for (uint64_t first = 0; first < games; first += GAMES_PER_BATCH) {
+            BatchSpec spec = {};
+            spec.id = static_cast<uint32_t>(batches.size());
+            spec.size = size;
+            spec.depth = AIPlayer::depthFor(size, config);
+            spec.count = static_cast<uint32_t>(min<uint64_t>(GAMES_PER_BATCH, games - first));
+            spec.seed = seed;
+            spec.firstGame = first;
+            spec.memoryBudget = share.memoryBudget;
+            spec.evalCacheSize = share.evalCacheSize;
+            spec.interleave = config.interleave;
+            memcpy(spec.sharedCacheName, share.sharedCacheName.c_str(), share.sharedCacheName.size() + 1);
+            batches.push_back(spec);
+        }
+        deque<uint32_t> queue;
+        for (const auto& spec : batches) queue.push_back(spec.id);
+        vector<vector<TrainingRecord>> staged(batches.size());
+        size_t finished = 0;
+
+        SelfPlayExporter::ShardWriter writer(prefix, -1, size_t(1) << 20);
+        SelfPlayExporter::Totals totals;
+        vector<Connection> connections;
+        unordered_set<pid_t> children;
+        int restartsLeft = RESTARTS_PER_WORKER * localWorkers;
+        for (int w = 0; w < localWorkers; w++) children.insert(spawnWorker(program));
+        chrono::steady_clock::duration slowestBatch(0);
+
+        auto assign = [&](Connection& c) {
+            if (queue.empty()) return true;
+            c.batch = static_cast<int>(queue.front());
+            c.assigned = chrono::steady_clock::now();
+            queue.pop_front();
+            return sendMessage(c.fd, MSG_BATCH, &batches[c.batch], sizeof(BatchSpec));
+        };
+        auto drop = [&](size_t k) {
+            Connection& c = connections[k];
+            if (c.batch >= 0) {
+                staged[c.batch].clear();
+                queue.push_front(static_cast<uint32_t>(c.batch));
+                cerr << "Worker lost; re-queued batch " << c.batch << endl;
+            }
+            close(c.fd);
+            connections.erase(connections.begin() + k);
+        };
+        // Handles one complete message; false when the worker has to be dropped
+        auto handleMessage = [&](Connection& c, uint32_t type, const char* data, size_t length) {
+            if (c.batch < 0 || length < sizeof(uint32_t) ||
+                *reinterpret_cast<const uint32_t*>(data) != static_cast<uint32_t>(c.batch)) {
+                return false;
+            }
+            if (type == MSG_RECORDS) {
+                size_t count = (length - sizeof(uint32_t)) / sizeof(TrainingRecord);
+                const TrainingRecord* records = reinterpret_cast<const TrainingRecord*>(data + sizeof(uint32_t));
+                staged[c.batch].insert(staged[c.batch].end(), records, records + count);
+                return true;
+            }
+            if (type != MSG_DONE || length != sizeof(BatchDone)) return false;
+            BatchDone done;
+            memcpy(&done, data, sizeof(done));
+            vector<TrainingRecord>& records = staged[c.batch];
+            writer.buffer.insert(writer.buffer.end(), records.begin(), records.end());
+            if (writer.buffer.size() >= SelfPlayExporter::BUFFER_RECORDS) writer.flush();
+            totals.games += done.games;
+            totals.records += records.size();
+            for (int w = 0; w < 3; w++) totals.wins[w] += done.wins[w];
+            vector<TrainingRecord>().swap(records);
+            finished++;
+            slowestBatch = max(slowestBatch, chrono::steady_clock::now() - c.assigned);
+            c.batch = -1;
+            return assign(c);
+        };
+
+        vector<pollfd> fds;
+        while (finished < batches.size()) {
+            int status;
+            for (pid_t pid; (pid = waitpid(-1, &status, WNOHANG)) > 0;) {
+                children.erase(pid);
+                bool failed = !WIFEXITED(status) || WEXITSTATUS(status) != 0;
+                if (failed && restartsLeft > 0) {
+                    restartsLeft--;
+                    children.insert(spawnWorker(program));
+                }
+            }
+            if (children.empty() && connections.empty() && localWorkers > 0) {
+                close(listenFd);
+                unlink(socketPath.c_str());
+                throw runtime_error("All workers failed");
+            }
+
+            // A worker that sits on its batch too long is cut off and its batch
+            // re-queued; a local one is killed so the restart above replaces it
+            auto timeout = max<chrono::steady_clock::duration>(chrono::seconds(BATCH_TIMEOUT_SECONDS),
+                                                               slowestBatch * BATCH_TIMEOUT_FACTOR);
+            auto now = chrono::steady_clock::now();
+            for (size_t k = connections.size(); k-- > 0;) {
+                Connection& c = connections[k];
+                if (c.batch < 0 || now - c.assigned < timeout) continue;
+                cerr << "Worker timed out on batch " << c.batch << endl;
+                if (c.pid > 0 && children.count(c.pid)) kill(c.pid, SIGKILL);
+                drop(k);
+            }
+
+            fds.assign(1, pollfd{listenFd, POLLIN, 0});
+            for (const auto& c : connections) fds.push_back(pollfd{c.fd, POLLIN, 0});
+            // On a timeout nothing has revents set, but idle workers still get re-queued batches
+            if (poll(fds.data(), fds.size(), 200) < 0) continue;
+
+            // Walk backwards so dropping a connection leaves earlier indices valid
+            for (size_t k = connections.size(); k-- > 0;) {
+                if (!(fds[k + 1].revents & (POLLIN | POLLHUP | POLLERR))) continue;
+                Connection& c = connections[k];
+                bool open = receiveAvailable(c);
+                bool ok = true;
+                size_t used = 0;
+                while (ok && c.inbox.size() - used >= sizeof(MessageHeader)) {
+                    MessageHeader header;
+                    memcpy(&header, c.inbox.data() + used, sizeof(header));
+                    if (header.length > MAX_MESSAGE_BYTES) {
+                        ok = false;
+                        break;
+                    }
+                    if (c.inbox.size() - used - sizeof(header) < header.length) break;
+                    ok = handleMessage(c, header.type, c.inbox.data() + used + sizeof(header), header.length);
+                    used += sizeof(header) + header.length;
+                }
+                c.inbox.erase(c.inbox.begin(), c.inbox.begin() + used);
+                if (!ok || !open) drop(k);
+            }
+
+            if (fds[0].revents & POLLIN) {
+                int fd = accept(listenFd, nullptr, nullptr);
+                if (fd >= 0) {
+                    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+                    connections.push_back(Connection{fd, -1, peerProcess(fd), {}, {}});
+                    if (!assign(connections.back())) drop(connections.size() - 1);
+                }
+            }
+
+            // Idle workers pick up batches that were re-queued after a crash
+            for (size_t k = connections.size(); k-- > 0;) {
+                if (connections[k].batch < 0 && !assign(connections[k])) drop(k);
+            }
+        }
+
+        writer.flush();
+        for (const auto& c : connections) {
+            sendMessage(c.fd, MSG_STOP, nullptr, 0);
+            close(c.fd);
+        }
+        // Workers cut off after a timeout may still be stuck; give them a moment
+        for (int wait = 0; wait < 50 && !children.empty(); wait++) {
+            for (pid_t pid; (pid = waitpid(-1, nullptr, WNOHANG)) > 0;) children.erase(pid);
+            if (!children.empty()) this_thread::sleep_for(chrono::milliseconds(100));
+        }
+        for (pid_t pid : children) {
+            kill(pid, SIGKILL);
+            waitpid(pid, nullptr, 0);
+        }
+        close(listenFd);
+        unlink(socketPath.c_str());
+        return totals;
+    }
+
+    // Worker side: plays batches from the coordinator at socketPath until told to stop
+    static int runWorker(const string& socketPath) {
+        signal(SIGPIPE, SIG_IGN);
+        sockaddr_un addr = unixSocketAddress(socketPath);
+        int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (fd < 0 || connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0) {
+            throw runtime_error("Cannot connect to " + socketPath + ": " + strerror(errno));
+        }
+
+        uint32_t type = 0;
+        vector<char> payload;
+        vector<TrainingRecord> out;
+        // Kept across batches while the settings stay the same, so later batches
+        // start with a warm cache instead of allocating a new one
+        shared_ptr<EvalCache> cache;
+        EngineConfig cacheConfig;
+        bool ok = true;
+        while (ok && receiveMessage(fd, type, payload) && type == MSG_BATCH && payload.size() == sizeof(BatchSpec)) {
+            BatchSpec spec;
+            memcpy(&spec, payload.data(), sizeof(spec));
+            EngineConfig engineConfig;
+            engineConfig.memoryBudget = spec.memoryBudget;
+            engineConfig.evalCacheSize = spec.evalCacheSize;
+            engineConfig.sharedCacheName.assign(spec.sharedCacheName,
+                                                strnlen(spec.sharedCacheName, sizeof(spec.sharedCacheName)));
+            if (!cache || engineConfig.evalCacheEntries() != cacheConfig.evalCacheEntries() ||
+                engineConfig.sharedCacheName != cacheConfig.sharedCacheName) {
+                cache.reset();
+                cache = make_shared<EvalCache>(engineConfig.sharedCacheName.empty()
+                    ? EvalCache(engineConfig.evalCacheEntries())
+                    : EvalCache::openShared(engineConfig.sharedCacheName, engineConfig.evalCacheEntries()));
+                cacheConfig = engineConfig;
+            }
+            SelfPlayLanes lanes(spec.size, spec.depth, spec.interleave, cache);
+            BatchDone done = {spec.id, 0, {0, 0, 0}};
+            out.clear();
+
+            uint32_t next = 0;
+            lanes.run(spec.seed, [&](uint64_t& g) {
+                g = spec.firstGame + next;
+                return ok && next++ < spec.count;
+            }, [&](char winner, const vector<TrainingRecord>& game) {
+                out.insert(out.end(), game.begin(), game.end());
+                done.games++;
+                done.wins[winner == 'X' ? 0 : winner == 'O' ? 1 : 2]++;
+                if (out.size() >= SelfPlayExporter::BUFFER_RECORDS) {
+                    ok = sendMessage(fd, MSG_RECORDS, &spec.id, sizeof(spec.id),
+                                     out.data(), out.size() * sizeof(TrainingRecord));
+                    out.clear();
+                }
+            });
+            ok = ok && sendMessage(fd, MSG_RECORDS, &spec.id, sizeof(spec.id),
+                                   out.data(), out.size() * sizeof(TrainingRecord)) &&
+                 sendMessage(fd, MSG_DONE, &done, sizeof(done));
+        }
+        close(fd);
+        return ok && type == MSG_STOP ? 0 : 1;
+    }
+};
+#endif
+
+// Reinforcement learning for PolicyValueNet: worker threads play batches of
+// games by MCTS on the current network and push every position into a replay
+// buffer; after each round of self-play the trainer runs minibatch SGD on
+// samples drawn from the buffer and writes the quantized network to disk.
+class NetTrainer {
+private:
+    int size;
+    EngineConfig config;
+    string netPath;
+    PolicyValueNet net;
+    deque<PolicyValueNet::Sample> replay;
+    mutex replayLock;
+
+    static const size_t REPLAY_CAPACITY = 50000;
+    static const int GAMES_PER_THREAD = 16;  // per round, searched in lockstep
+    static const int SIMULATIONS = 200;
+    static const int TRAIN_STEPS = 200;
+    static const int BATCH_SIZE = 64;
+    static constexpr float LEARNING_RATE = 0.02f;
+
+    // Resumes from an existing network file, otherwise starts from random weights
+    static PolicyValueNet loadOrCreate(int boardSize, const string& path, uint64_t seed) {
+        if (!ifstream(path)) return PolicyValueNet(boardSize, seed);
+        PolicyValueNet loaded = PolicyValueNet::load(path);
+        if (loaded.getSize() != boardSize) {
+            throw runtime_error(path + " holds a network for another board size");
+        }
+        return loaded;
+    }
+
+public:
+    struct RoundStats {
+        size_t games = 0;
+        size_t samples = 0;
+        size_t wins[3] = {0, 0, 0};  // X, O, draw
+        float loss = 0;
+    };
+
+    NetTrainer(int boardSize, const EngineConfig& engineConfig, const string& path, uint64_t seed)
+        : size(boardSize), config(engineConfig), netPath(path), net(loadOrCreate(boardSize, path, seed)) {}
+
+    RoundStats round(uint64_t seed) {
+        int threads = max(1, config.threads);
+        vector<RoundStats> perThread(threads);
+        mutex errorLock;
+        string error;
+
+        auto worker = [&](int id) {
+            try {
+                uint64_t rng = seed ^ (0x9E3779B97F4A7C15ULL * (id + 1));
+                MctsBatch mcts(net);
+                vector<Board> boards(GAMES_PER_THREAD, Board(size));
+                vector<char> turns(GAMES_PER_THREAD);
+                vector<vector<PolicyValueNet::Sample>> histories(GAMES_PER_THREAD);
+                vector<vector<char>> movers(GAMES_PER_THREAD);
+                vector<int> active;
+                for (int g = 0; g < GAMES_PER_THREAD; g++) {
+                    turns[g] = (splitMix64(rng) & 1) ? 'X' : 'O';
+                    active.push_back(g);
+                }
+
+                for (int ply = 0; !active.empty(); ply++) {
+                    vector<Board*> searched;
+                    vector<char> toMove;
+                    for (int g : active) {
+                        searched.push_back(&boards[g]);
+                        toMove.push_back(turns[g]);
+                    }
+                    vector<MctsBatch::Result> results = mcts.search(searched, toMove, SIMULATIONS, rng, true);
+
+                    vector<int> stillActive;
+                    for (size_t k = 0; k < active.size(); k++) {
+                        int g = active[k];
+                        const vector<float>& visits = results[k].visits;
+                        float total = 0;
+                        for (float v : visits) total += v;
+
+                        PolicyValueNet::Sample sample;
+                        sample.input.resize(net.inputCount());
+                        net.encode(boards[g], turns[g], sample.input.data());
+                        for (float v : visits) sample.policy.push_back(v / total);
+                        sample.value = 0;
+                        histories[g].push_back(std::move(sample));
+                        movers[g].push_back(turns[g]);
+
+                        // Opening moves follow the visit counts so games diverge; later ones are greedy
+                        int move = 0;
+                        if (ply < size) {
+                            float pick = static_cast<float>(splitMix64(rng) >> 40) / (1 << 24) * total;
+                            for (move = 0; move < size * size - 1 && (pick -= visits[move]) >= 0; move++) {}
+                            while (visits[move] == 0) move--;
+                        } else {
+                            move = static_cast<int>(max_element(visits.begin(), visits.end()) - visits.begin());
+                        }
+                        boards[g].set(move, turns[g]);
+                        turns[g] = (turns[g] == 'X') ? 'O' : 'X';
+
+                        char winner = boards[g].checkWinner();
+                        if (winner == '\0') {
+                            stillActive.push_back(g);
+                            continue;
+                        }
+                        RoundStats& stats = perThread[id];
+                        stats.games++;
+                        stats.samples += histories[g].size();
+                        stats.wins[winner == 'X' ? 0 : winner == 'O' ? 1 : 2]++;
+                        for (size_t i = 0; i < histories[g].size(); i++) {
+                            histories[g][i].value = winner == 'D' ? 0.0f : (winner == movers[g][i] ? 1.0f : -1.0f);
+                        }
+                        lock_guard<mutex> lock(replayLock);
+                        for (auto& s : histories[g]) {
+                            if (replay.size() == REPLAY_CAPACITY) replay.pop_front();
+                            replay.push_back(std::move(s));
+                        }
+                    }
+                    active.swap(stillActive);
+                }
+            } catch (const exception& e) {
+                lock_guard<mutex> lock(errorLock);
+                error = e.what();
+            }
+        };
+
+        vector<thread> pool;
+        for (int t = 1; t < threads; t++) pool.emplace_back(worker, t);
+        worker(0);
+        for (auto& t : pool) t.join();
+        if (!error.empty()) throw runtime_error(error);
+
+        RoundStats totals;
+        for (const auto& t : perThread) {
+            totals.games += t.games;
+            totals.samples += t.samples;
+            for (int k = 0; k < 3; k++) totals.wins[k] += t.wins[k];
+        }
+
+        uint64_t rng = seed;
+        vector<const PolicyValueNet::Sample*> batch(BATCH_SIZE);
+        for (int step = 0; step < TRAIN_STEPS; step++) {
+            for (auto& s : batch) s = &replay[splitMix64(rng) % replay.size()];
+            totals.loss += net.train(batch, LEARNING_RATE) / TRAIN_STEPS;
+        }
+        net.save(netPath);
+        return totals;
+    }
+};
+
+// Machine-specific settings measured by --calibrate and cached in a local file,
+// so the fixed depths of AIPlayer::getMaxDepth can follow the CPU they run on.
+struct Calibration {
+    static constexpr const char* FILE_NAME = "tictactoe.calibration";
+
+    double targetMs = 0;
+    double nodesPerSecond = 0;   // single thread
+    int threads = 0;             // workers that still scale well
+    size_t evalCacheSize = 0;
+    int sizeDepths[7] = {0, 0, 0, 0, 0, 0, 0};
+
+    bool valid() const { return targetMs > 0; }
+
+    bool load(const string& path) {
+        ifstream in(path);
+        if (!in) return false;
+        string key;
+        while (in >> key) {
+            if (key == "target_ms") in >> targetMs;
+            else if (key == "nodes_per_second") in >> nodesPerSecond;
+            else if (key == "threads") in >> threads;
+            else if (key == "eval_cache_entries") in >> evalCacheSize;
+            else if (key.rfind("depth_", 0) == 0) {
+                int size = atoi(key.c_str() + 6);
+                int depth = 0;
+                in >> depth;
+                if (size >= 3 && size <= 6) sizeDepths[size] = depth;
+            } else {
+                in.ignore(numeric_limits<streamsize>::max(), '\n');
+            }
+        }
+        return valid();
+    }
+
+    void save(const string& path) const {
+        ofstream out(path, ios::trunc);
+        if (!out) throw runtime_error("Cannot write " + path);
+        out << "target_ms " << targetMs << "\n"
+            << "nodes_per_second " << static_cast<uint64_t>(nodesPerSecond) << "\n"
+            << "threads " << threads << "\n"
+            << "eval_cache_entries " << evalCacheSize << "\n";
+        for (int size = 3; size <= 6; size++) {
+            out << "depth_" << size << " " << sizeDepths[size] << "\n";
+        }
+    }
+
+    // Fills in only what the command line left unset
+    void applyTo(EngineConfig& config) const {
+        if (!valid()) return;
+        if (config.threads == 0) config.threads = threads;
+        if (config.evalCacheSize == 0) config.evalCacheSize = evalCacheSize;
+        for (int size = 3; size <= 6; size++) {
+            if (config.sizeDepths[size] == 0) config.sizeDepths[size] = sizeDepths[size];
+        }
+    }
+
+    // Nodes searched per second by one engine on the empty 5x5 board at depth 3
+    static double measureNodesPerSecond(double seconds) {
+        uint64_t nodes = 0;
+        auto start = chrono::steady_clock::now();
+        double elapsed = 0;
+        while (elapsed < seconds) {
+            Board board(5);
+            AIEngine engine('X', 'O', 3);
+            engine.getBestMove(board);
+            nodes += engine.getStats().nodes;
+            elapsed = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        }
+        return nodes / elapsed;
+    }
+
+    // Short micro-benchmark: single-thread speed, thread scaling, and for each board
+    // size the deepest search whose first move (the slowest one) fits in targetMs
+    static Calibration measure(double targetMs, ostream& log) {
+        Calibration result;
+        result.targetMs = targetMs;
+        result.nodesPerSecond = measureNodesPerSecond(0.25);
+        log << "Calibrating: " << static_cast<uint64_t>(result.nodesPerSecond) << " nodes/s per thread" << endl;
+
+        result.threads = 1;
+        int hardware = max(1u, thread::hardware_concurrency());
+        for (int threads = 2; threads <= hardware; threads *= 2) {
+            vector<double> rates(threads);
+            vector<thread> pool;
+            for (int t = 0; t < threads; t++) {
+                pool.emplace_back([&rates, t] { rates[t] = measureNodesPerSecond(0.25); });
+            }
+            for (auto& t : pool) t.join();
+            double total = 0;
+            for (double rate : rates) total += rate;
+            double efficiency = total / (threads * result.nodesPerSecond);
+            log << "  " << threads << " threads: " << fixed << setprecision(0) << efficiency * 100
+                << "% scaling" << defaultfloat << endl;
+            if (efficiency < 0.7) break;
+            result.threads = threads;
+        }
+
+        // Enough slots for a quarter of the leaves one target-length search visits
+        size_t leaves = static_cast<size_t>(result.nodesPerSecond * targetMs / 1000 / 4);
+        size_t entries = EvalCache::DEFAULT_ENTRIES;
+        while (entries < leaves && entries < (size_t(1) << 22)) entries *= 2;
+        result.evalCacheSize = entries;
+
+        result.sizeDepths[3] = AIPlayer::getMaxDepth(3);  // 3x3 is always solved outright
+        for (int size = 4; size <= 6; size++) {
+            int best = 1;
+            double previousMs = 0;
+            for (int depth = 1; depth < size * size; depth++) {
+                Board board(size);
+                AIEngine engine('X', 'O', depth);
+                auto start = chrono::steady_clock::now();
+                engine.getBestMove(board);
+                double ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+                if (ms > targetMs) break;
+                best = depth;
+                // Skip the next depth when its growth rate already puts it far past the target
+                double growth = previousMs > 0 ? ms / previousMs : size * size;
+                if (ms * growth > targetMs * 3) break;
+                previousMs = max(ms, 0.01);
+            }
+            result.sizeDepths[size] = best;
+            log << "  " << size << "x" << size << ": depth " << best << endl;
+        }
+        return result;
+    }
+};
+
+// Benchmark mode shared with script.py: each input line is "<depth> <compact position>"
+// with X to move, and each output line is "<move> <score> <nodes> <microseconds>".
+// A final "# peak-rss-kb <n>" line reports the process's peak memory use.
+int runBench(istream& in, ostream& out, const EngineConfig& config) {
+    int depth;
+    string position;
+    while (in >> depth >> position) {
+        Board board = Board::fromCompact(position);
+        if (board.checkWinner() != '\0') throw invalid_argument("Position is already decided: " + position);
+        AIEngine engine('X', 'O', depth, config);
+        auto start = chrono::steady_clock::now();
+        int move = engine.getBestMove(board);
+        auto elapsed = chrono::duration_cast<chrono::microseconds>(
+            chrono::steady_clock::now() - start);
+        out << move << " " << engine.getLastScore() << " " << engine.getStats().nodes
+            << " " << elapsed.count() << endl;
+    }
+    out << "# peak-rss-kb " << peakRssKb() << endl;
+    return 0;
+}
+
+int promptBoardSize() {
+    int size;
+    while (true) {
+        cout << "Choose board size (3-6): ";
+        
+        if (!(cin >> size)) {
+            cin.clear();
+            cin.ignore(numeric_limits<streamsize>::max(), '\n');
+            cout << "Please enter a valid number." << endl;
+            continue;
+        }
+        
+        if (size >= 3 && size <= 6) return size;
+        cout << "Please enter a number between 3 and 6." << endl;
+    }
+}
+
+// Position generation mode: writes count compact positions of the given size and fill
+int runGenerate(int size, int filled, size_t count, const EngineConfig& config, ostream& out) {
+    PositionGenerator generator(size, filled);
+    auto start = chrono::steady_clock::now();
+    size_t written = generator.generate(count, config.threads,
+                                        static_cast<uint64_t>(time(nullptr)), out);
+    out.flush();
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    cerr << "Generated " << written << " positions in " << fixed << setprecision(2)
+         << seconds << "s (" << setprecision(0) << written / max(seconds, 1e-9)
+         << " positions/s)" << endl;
+    if (written < count) {
+        cerr << "Only " << written << " distinct positions could be found" << endl;
+    }
+    return 0;
+}
+
+// Position index mode: how many positions of the given size get an index and,
+// when the class table fits in memory, how many classes remain after symmetry
+int runClasses(int size, ostream& out) {
+    PositionIndexer indexer(size);
+    out << size << "x" << size << ": " << indexer.count() << " positions" << endl;
+    auto start = chrono::steady_clock::now();
+    if (!indexer.buildClassTable()) {
+        cerr << "Too many positions for a symmetry class table" << endl;
+        return 0;
+    }
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    out << size << "x" << size << ": " << indexer.classCount() << " symmetry classes" << endl;
+    cerr << "Built the class table in " << fixed << setprecision(2) << seconds << "s" << endl;
+    return 0;
+}
+
+// Self-play export mode: plays games AI vs AI and writes training shards under prefix
+int runSelfPlay(int size, size_t games, const string& prefix, const EngineConfig& config) {
+    SelfPlayExporter exporter(size, config, prefix);
+    auto start = chrono::steady_clock::now();
+    SelfPlayExporter::Totals totals = exporter.run(games, static_cast<uint64_t>(time(nullptr)));
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    cerr << "Played " << totals.games << " games (X " << totals.wins[0] << ", O " << totals.wins[1]
+         << ", draws " << totals.wins[2] << "), wrote " << totals.records << " records in "
+         << fixed << setprecision(2) << seconds << "s (" << setprecision(0)
+         << totals.records / max(seconds, 1e-9) * 60 << " records/min)" << endl;
+    return 0;
+}
+
+// Multi-process self-play: a coordinator with local worker processes, or one worker
+int runCoordinator(int size, size_t games, const string& prefix, int workers, const string& socketPath,
+                   const string& program, const EngineConfig& config) {
+#ifdef TTT_HAVE_SOCKETS
+    SelfPlayCoordinator coordinator(size, config, prefix, socketPath.empty() ? prefix + ".sock" : socketPath);
+    auto start = chrono::steady_clock::now();
+    SelfPlayExporter::Totals totals = coordinator.run(games, workers, program, static_cast<uint64_t>(time(nullptr)));
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    cerr << "Played " << totals.games << " games (X " << totals.wins[0] << ", O " << totals.wins[1]
+         << ", draws " << totals.wins[2] << "), wrote " << totals.records << " records in "
+         << fixed << setprecision(2) << seconds << "s" << endl;
+    return 0;
+#else
+    (void)size, (void)games, (void)prefix, (void)workers, (void)socketPath, (void)program, (void)config;
+    throw runtime_error("--coordinator needs Unix-domain sockets");
+#endif
+}
+
+int runWorker(const string& socketPath) {
+#ifdef TTT_HAVE_SOCKETS
+    return SelfPlayCoordinator::runWorker(socketPath);
+#else
+    (void)socketPath;
+    throw runtime_error("--worker needs Unix-domain sockets");
+#endif
+}
+
+// Training mode: rounds of self-play and SGD, saving the network after each
+int runTraining(int size, int rounds, const string& netPath, const EngineConfig& config) {
+    uint64_t seed = static_cast<uint64_t>(time(nullptr));
+    NetTrainer trainer(size, config, netPath, seed);
+    for (int r = 1; r <= rounds; r++) {
+        auto start = chrono::steady_clock::now();
+        NetTrainer::RoundStats stats = trainer.round(splitMix64(seed));
+        double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        cerr << "Round " << r << ": " << stats.games << " games (X " << stats.wins[0] << ", O "
+             << stats.wins[1] << ", draws " << stats.wins[2] << "), " << stats.samples
+             << " samples, loss " << fixed << setprecision(3) << stats.loss << ", "
+             << setprecision(2) << seconds << "s" << defaultfloat << endl;
+    }
+    cerr << "Wrote " << netPath << endl;
+    return 0;
+}
+
+// Playout benchmark: random games from the empty board on every worker thread
+int runPlayouts(int size, uint64_t playouts, const EngineConfig& config) {
+    PlayoutKernel kernel(size);
+    Board start(size);
+    int threads = max(1, config.threads);
+    vector<PlayoutKernel::Result> results(threads);
+    auto begin = chrono::steady_clock::now();
+    vector<thread> pool;
+    for (int t = 0; t < threads; t++) {
+        uint64_t share = playouts / threads + (t < static_cast<int>(playouts % threads) ? 1 : 0);
+        pool.emplace_back([&, t, share] {
+            uint64_t seed = static_cast<uint64_t>(time(nullptr)) + t;
+            results[t] = kernel.run(start, 'X', share, splitMix64(seed));
+        });
+    }
+    for (auto& t : pool) t.join();
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - begin).count();
+
+    PlayoutKernel::Result total;
+    for (const auto& r : results) {
+        total.xWins += r.xWins;
+        total.oWins += r.oWins;
+        total.draws += r.draws;
+    }
+    cout << total.total() << " playouts on " << size << "x" << size << " (" << PlayoutKernel::kernelName()
+         << " kernel, " << PlayoutKernel::LANES << " lanes) in " << fixed << setprecision(2) << seconds
+         << "s: " << setprecision(0) << total.total() / max(seconds, 1e-9) / threads
+         << " playouts/s per core" << endl;
+    cout << "X wins " << total.xWins << ", O wins " << total.oWins << ", draws " << total.draws << endl;
+    return 0;
+}
+
+// Whole argument as an unsigned integer within [low, high]. Signs, blanks and
+// trailing text are rejected rather than read as 0 the way atoi would.
+static bool parseInteger(const char* text, uint64_t low, uint64_t high, uint64_t& value) {
+    if (!isdigit(static_cast<unsigned char>(text[0]))) return false;
+    errno = 0;
+    char* end;
+    unsigned long long parsed = strtoull(text, &end, 10);
+    if (errno != 0 || *end != '\0' || parsed < low || parsed > high) return false;
+    value = parsed;
+    return true;
+}
+
+// Whole argument as a positive number below high, fractions allowed
+static bool parsePositive(const char* text, double high, double& value) {
+    char* end;
+    double parsed = strtod(text, &end);
+    if (end == text || *end != '\0' || !(parsed > 0) || !(parsed < high)) return false;
+    value = parsed;
+    return true;
+}
+
+// Positive size in megabytes, fractions allowed, converted to bytes
+static bool parseMegabytes(const char* text, size_t& bytes) {
+    double megabytes;
+    if (!parsePositive(text, static_cast<double>(numeric_limits<size_t>::max() >> 20), megabytes)) return false;
+    bytes = static_cast<size_t>(megabytes * 1024 * 1024);
+    return bytes > 0;
+}
+
+// Upper bounds for the per-run counts on the command line
+static const int MAX_THREADS = 1024;
+static const int MAX_INTERLEAVE = 64;
+static const double MAX_SECONDS = 1e6;
+
+static int printUsage(const char* program) {
+    cerr << "Usage: " << program << " [--snapshot FILE] [--spectate SOCKET] [--clock SECONDS]\n"
+         << "       [--mem MB] [--threads N] [--interleave N] [--depth D] [--calibrate TARGET_MS] [--shm-cache NAME] [--net FILE]\n"
+         << "       [--bench | --generate SIZE FILLED COUNT | --classes SIZE | --selfplay SIZE GAMES PREFIX |\n"
+         << "        --playouts SIZE COUNT | --train SIZE ROUNDS NETFILE |\n"
+         << "        --coordinator SIZE GAMES PREFIX [--workers N] [--socket PATH] | --worker SOCKET]\n"
+         << "SIZE is 3-6, FILLED below SIZE*SIZE; COUNT, GAMES and ROUNDS must be at least 1;\n"
+         << "N is 1-" << MAX_THREADS << " (--workers may be 0), --interleave 1-" << MAX_INTERLEAVE
+         << ", D 1-" << Board::MAX_CELLS << "; MB, SECONDS and TARGET_MS must be positive." << endl;
+    return 1;
+}
+
+int main(int argc, char* argv[]) {
+    string snapshotPath;
+    string spectatePath;
+    bool bench = false;
+    int generateArgs[2] = {0, 0};
+    size_t generateCount = 0;
+    int classesSize = 0;
+    int selfPlaySize = 0;
+    size_t selfPlayGames = 0;
+    string selfPlayPrefix;
+    int playoutSize = 0;
+    uint64_t playoutCount = 0;
+    int coordinatorSize = 0;
+    size_t coordinatorGames = 0;
+    string coordinatorPrefix;
+    int workers = max(1, static_cast<int>(thread::hardware_concurrency()));
+    string socketPath;
+    string workerSocket;
+    int trainSize = 0;
+    int trainRounds = 0;
+    string trainPath;
+    double clockSeconds = 0;
+    double calibrateMs = 0;
+    EngineConfig config;
+    for (int a = 1; a < argc; a++) {
+        string arg = argv[a];
+        if (arg == "--snapshot" && a + 1 < argc) {
+            snapshotPath = argv[++a];
+        } else if (arg == "--spectate" && a + 1 < argc) {
+            spectatePath = argv[++a];
+        } else if (arg == "--bench") {
+            bench = true;
+        } else if (arg == "--mem" && a + 1 < argc) {
+            if (!parseMegabytes(argv[++a], config.memoryBudget)) return printUsage(argv[0]);
+        } else if (arg == "--threads" && a + 1 < argc) {
+            uint64_t threads;
+            if (!parseInteger(argv[++a], 1, MAX_THREADS, threads)) return printUsage(argv[0]);
+            config.threads = static_cast<int>(threads);
+        } else if (arg == "--interleave" && a + 1 < argc) {
+            uint64_t lanes;
+            if (!parseInteger(argv[++a], 1, MAX_INTERLEAVE, lanes)) return printUsage(argv[0]);
+            config.interleave = static_cast<int>(lanes);
+        } else if (arg == "--generate" && a + 3 < argc) {
+            uint64_t size, filled, count;
+            if (!parseInteger(argv[a + 1], 3, 6, size) || !parseInteger(argv[a + 2], 0, size * size - 1, filled) ||
+                !parseInteger(argv[a + 3], 1, numeric_limits<size_t>::max(), count)) {
+                return printUsage(argv[0]);
+            }
+            generateArgs[0] = static_cast<int>(size);
+            generateArgs[1] = static_cast<int>(filled);
+            generateCount = count;
+            a += 3;
+        } else if (arg == "--classes" && a + 1 < argc) {
+            uint64_t size;
+            if (!parseInteger(argv[++a], 3, 6, size)) return printUsage(argv[0]);
+            classesSize = static_cast<int>(size);
+        } else if (arg == "--selfplay" && a + 3 < argc) {
+            uint64_t size, games;
+            if (!parseInteger(argv[a + 1], 3, 6, size) ||
+                !parseInteger(argv[a + 2], 1, numeric_limits<size_t>::max(), games)) {
+                return printUsage(argv[0]);
+            }
+            selfPlaySize = static_cast<int>(size);
+            selfPlayGames = games;
+            selfPlayPrefix = argv[a + 3];
+            a += 3;
+        } else if (arg == "--playouts" && a + 2 < argc) {
+            uint64_t size;
+            if (!parseInteger(argv[a + 1], 3, 6, size) ||
+                !parseInteger(argv[a + 2], 1, numeric_limits<uint64_t>::max(), playoutCount)) {
+                return printUsage(argv[0]);
+            }
+            playoutSize = static_cast<int>(size);
+            a += 2;
+        } else if (arg == "--coordinator" && a + 3 < argc) {
+            uint64_t size, games;
+            if (!parseInteger(argv[a + 1], 3, 6, size) ||
+                !parseInteger(argv[a + 2], 1, numeric_limits<size_t>::max(), games)) {
+                return printUsage(argv[0]);
+            }
+            coordinatorSize = static_cast<int>(size);
+            coordinatorGames = games;
+            coordinatorPrefix = argv[a + 3];
+            a += 3;
+        } else if (arg == "--workers" && a + 1 < argc) {
+            uint64_t count;
+            if (!parseInteger(argv[++a], 0, MAX_THREADS, count)) return printUsage(argv[0]);
+            workers = static_cast<int>(count);
+        } else if (arg == "--socket" && a + 1 < argc) {
+            socketPath = argv[++a];
+        } else if (arg == "--worker" && a + 1 < argc) {
+            workerSocket = argv[++a];
+        } else if (arg == "--train" && a + 3 < argc) {
+            uint64_t size, rounds;
+            if (!parseInteger(argv[a + 1], 3, 6, size) ||
+                !parseInteger(argv[a + 2], 1, numeric_limits<int>::max(), rounds)) {
+                return printUsage(argv[0]);
+            }
+            trainSize = static_cast<int>(size);
+            trainRounds = static_cast<int>(rounds);
+            trainPath = argv[a + 3];
+            a += 3;
+        } else if (arg == "--net" && a + 1 < argc) {
+            config.netPath = argv[++a];
+        } else if (arg == "--shm-cache" && a + 1 < argc) {
+            config.sharedCacheName = argv[++a];
+        } else if (arg == "--calibrate" && a + 1 < argc) {
+            if (!parsePositive(argv[++a], MAX_SECONDS * 1000, calibrateMs)) return printUsage(argv[0]);
+        } else if (arg == "--clock" && a + 1 < argc) {
+            if (!parsePositive(argv[++a], MAX_SECONDS, clockSeconds)) return printUsage(argv[0]);
+        } else if (arg == "--depth" && a + 1 < argc) {
+            uint64_t depth;
+            if (!parseInteger(argv[++a], 1, Board::MAX_CELLS, depth)) return printUsage(argv[0]);
+            config.depth = static_cast<int>(depth);
+        } else {
+            return printUsage(argv[0]);
+        }
+    }
+
+    // Measured settings fill in whatever the command line did not set
+    Calibration calibration;
+    if (calibrateMs > 0) {
+        calibration = Calibration::measure(calibrateMs, cerr);
+        try {
+            calibration.save(Calibration::FILE_NAME);
+        } catch (const exception& e) {
+            cerr << "Warning: " << e.what() << endl;
+        }
+    } else {
+        calibration.load(Calibration::FILE_NAME);
+    }
+    calibration.applyTo(config);
+
+    if (!workerSocket.empty()) {
+        try {
+            return runWorker(workerSocket);
+        } catch (const exception& e) {
+            cerr << "Error: " << e.what() << endl;
+            return 1;
+        }
+    }
+
+    if (coordinatorGames > 0) {
+        try {
+            return runCoordinator(coordinatorSize, coordinatorGames, coordinatorPrefix, workers, socketPath,
+                                  argv[0], config);
+        } catch (const exception& e) {
+            cerr << "Error: " << e.what() << endl;
+            return 1;
+        }
+    }
+
+    if (trainRounds > 0) {
+        try {
+            return runTraining(trainSize, trainRounds, trainPath, config);
+        } catch (const exception& e) {
+            cerr << "Error: " << e.what() << endl;
+            return 1;
+        }
+    }
+
+    if (playoutCount > 0) {
+        try {
+            return runPlayouts(playoutSize, playoutCount, config);
+        } catch (const exception& e) {
+            cerr << "Error: " << e.what() << endl;
+            return 1;
+        }
+    }
+
+    if (selfPlayGames > 0) {
+        try {
+            return runSelfPlay(selfPlaySize, selfPlayGames, selfPlayPrefix, config);
+        } catch (const exception& e) {
+            cerr << "Error: " << e.what() << endl;
+            return 1;
+        }
+    }
+
+    if (classesSize > 0) {
+        try {
+            return runClasses(classesSize, cout);
+        } catch (const exception& e) {
+            cerr << "Error: " << e.what() << endl;
+            return 1;
+        }
+    }
+
+    if (generateCount > 0) {
+        try {
+            return runGenerate(generateArgs[0], generateArgs[1], generateCount, config, cout);
+        } catch (const exception& e) {
+            cerr << "Error: " << e.what() << endl;
+            return 1;
+        }
+    }
+
+    if (bench) {
+        try {
+            return runBench(cin, cout, config);
+        } catch (const exception& e) {
+            cerr << "Error: " << e.what() << endl;
+            return 1;
+        }
+    }
+
+    cout << string(40, '=') << endl;
+    cout << "      TIC-TAC-TOE" << endl;
+    cout << string(40, '=') << endl;
+
     try {
-        Game game(size);
-        game.play();
+        unique_ptr<Game> game;
+        if (!snapshotPath.empty()) game = Game::restoreSnapshot(snapshotPath, config);
+        if (!game) game = make_unique<Game>(promptBoardSize(), config);
+        game->setSnapshotPath(snapshotPath);
+        if (!spectatePath.empty()) game->setSpectatorSocket(spectatePath);
+        // A restored timed game keeps the time both sides had left
+        if (clockSeconds > 0 && !game->isTimed()) game->setClock(clockSeconds);
+        game->play();
     } catch (const exception& e) {
         cerr << "Error: " << e.what() << endl;
         return 1;
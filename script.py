@@ -1,5 +1,7 @@
 import math
 import random
+import sys
+import time
 from abc import ABC, abstractmethod
 
 
@@ -51,6 +53,18 @@ class Board:
             return 'DRAW'
         return None
 
+    @staticmethod
+    def from_compact(text: str) -> 'Board':
+        """Parses row-major cells with '.' for empty, e.g. "X...O...." for a 3x3 board."""
+        size = math.isqrt(len(text))
+        if size * size != len(text):
+            raise ValueError(f"Compact position length must be a square: {text}")
+        if any(ch not in 'XO.' for ch in text):
+            raise ValueError(f"Compact position may only hold X, O and '.': {text}")
+        board = Board(size)
+        board.cells = [Board.EMPTY if ch == '.' else ch for ch in text]
+        return board
+
     def copy(self) -> 'Board':
         new_board = Board(self.size)
         new_board.cells = self.cells.copy()
@@ -99,11 +113,14 @@ class HumanPlayer(Player):
 class AIEngine:
     WIN_SCORE = 1000000
     LOSS_SCORE = -1000000
+    QUIESCENCE_MAX_PLIES = 8
 
     def __init__(self, ai_symbol: str, human_symbol: str, max_depth: int):
         self.ai_symbol = ai_symbol
         self.human_symbol = human_symbol
         self.max_depth = max_depth
+        self.nodes = 0
+        self.last_score = 0
 
     def evaluate_board(self, board: Board) -> int:
         score = 0
@@ -139,7 +156,53 @@ class AIEngine:
 
         return score
 
+    def quiesce(self, board: Board, is_maximizing: bool, plies_left: int) -> int:
+        """Horizon search limited to n-1 lines, mirroring AIEngine::quiesce in script.cpp.
+
+        A side that can complete a line wins; one facing two open n-1 lines loses;
+        one facing a single line must block it, which is played out. Otherwise the
+        position is quiet and gets its static score."""
+        mover = self.ai_symbol if is_maximizing else self.human_symbol
+        n = board.size
+        win_cell = block_cell = None
+        double_threat = False
+
+        for line in board.win_lines:
+            mover_count = other_count = 0
+            empty_cell = None
+            for idx in line:
+                val = board.get(idx)
+                if val == mover:
+                    mover_count += 1
+                elif val == Board.EMPTY:
+                    empty_cell = idx
+                else:
+                    other_count += 1
+            if mover_count == n - 1 and other_count == 0:
+                if win_cell is None:
+                    win_cell = empty_cell
+            elif other_count == n - 1 and mover_count == 0:
+                if block_cell is not None and block_cell != empty_cell:
+                    double_threat = True
+                if block_cell is None:
+                    block_cell = empty_cell
+
+        if win_cell is not None:
+            return self.WIN_SCORE if is_maximizing else self.LOSS_SCORE
+        if double_threat:
+            return self.LOSS_SCORE if is_maximizing else self.WIN_SCORE
+        if block_cell is None or plies_left == 0:
+            return self.evaluate_board(board)
+
+        self.nodes += 1
+        board.set(block_cell, mover)
+        # A block cannot complete a line for the mover, so the only way this ends is a full board
+        score = 0 if board.is_full() else self.quiesce(board, not is_maximizing, plies_left - 1)
+        board.set(block_cell, Board.EMPTY)
+        return score
+
     def minimax(self, board: Board, depth: int, alpha: float, beta: float, is_maximizing: bool) -> float:
+        self.nodes += 1
         winner = board.check_winner()
         if winner == self.ai_symbol:
             return self.WIN_SCORE
@@ -149,7 +212,7 @@ class AIEngine:
             return 0
 
         if depth == 0:
-            return self.evaluate_board(board)
+            return self.quiesce(board, is_maximizing, self.QUIESCENCE_MAX_PLIES)
 
         empty_cells = board.get_empty_cells()
 
@@ -177,6 +240,7 @@ class AIEngine:
             return min_eval
 
     def get_best_move(self, board: Board) -> int:
+        self.nodes = 0
         best_score = -math.inf
         best_move = -1
         for i in board.get_empty_cells():
@@ -186,6 +250,7 @@ class AIEngine:
             if score > best_score:
                 best_score = score
                 best_move = i
+        self.last_score = best_score
         return best_move
 
 
@@ -268,5 +333,48 @@ def main():
     game.play()
 
 
+def bench():
+    """Benchmark mode shared with script.cpp: each input line is "<depth> <compact position>"
+    with X to move, and each output line is "<move> <score> <nodes> <microseconds>".
+    A final "# peak-rss-kb <n>" line reports the process's peak memory use."""
+    for line in sys.stdin:
+        if not line.strip():
+            continue
+        depth, position = line.split()
+        board = Board.from_compact(position)
+        if board.check_winner() is not None:
+            raise ValueError(f"Position is already decided: {position}")
+        engine = AIEngine('X', 'O', int(depth))
+        start = time.perf_counter()
+        move = engine.get_best_move(board)
+        elapsed = int((time.perf_counter() - start) * 1_000_000)
+        print(move, int(engine.last_score), engine.nodes, elapsed, flush=True)
+    print("# peak-rss-kb", peak_rss_kb())
+
+
+def peak_rss_kb() -> int:
+    """Peak resident set size in KiB, or -1 where the platform does not report it.
+    Linux's VmHWM is used first because ru_maxrss carries over the parent's peak across exec."""
+    try:
+        with open("/proc/self/status") as status:
+            for line in status:
+                if line.startswith("VmHWM:"):
+                    return int(line.split()[1])
+    except OSError:
+        pass
+    try:
+        import resource
+    except ImportError:
+        return -1
+    peak = resource.getrusage(resource.RUSAGE_SELF).ru_maxrss
+    return peak // 1024 if sys.platform == "darwin" else peak
+
 if __name__ == "__main__":
-    main()
\ No newline at end of file
+    if sys.argv[1:] == ["--bench"]:
+        try:
+            bench()
+        except ValueError as e:
+            print(f"Error: {e}", file=sys.stderr)
+            sys.exit(1)
+    else:
+        main()
\ No newline at end of file